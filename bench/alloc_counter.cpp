@@ -0,0 +1,49 @@
+#include <atomic>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+
+#include "alloc_counter.h"
+
+// Replaces the global operator new and delete for the whole program, so
+// linking this file is all it takes to count allocations. Only the count is
+// kept, a relaxed atomic increment per allocation.
+
+static std::atomic<uint64_t> allocations = 0;
+
+uint64_t allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+static void *allocate(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+static void *allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = std::max(std::size_t(alignment), sizeof(void *));
+    // aligned_alloc wants the size to be a multiple of the alignment
+    if (void *p = std::aligned_alloc(align, (size + align - 1) / align * align)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { try { return allocate(size); } catch (...) { return nullptr; } }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { try { return allocate(size); } catch (...) { return nullptr; } }
+void *operator new(std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void *operator new[](std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
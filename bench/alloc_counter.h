@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// heap allocations made through operator new since the program started,
+// counted by the replacement operators in alloc_counter.cpp
+uint64_t allocationCount();
@@ -0,0 +1,512 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "raymath.h"
+
+#include "alloc_counter.h"
+#include "governor.h"
+#include "neighbor_kernel.h"
+#include "recording.h"
+#include "sim.h"
+#include "tiles.h"
+
+struct BenchOptions {
+    int count = 10000;
+    // the flock spawned, the same for the same seed whatever the thread
+    // count; 0 keeps the default seed
+    uint64_t seed = 0;
+    int frames = 600;
+    int warmup = 60;
+    float dt = 1.0f / 60.0f;
+    float width = 1080;
+    float height = 520;
+    SpatialMode spatialMode = SPATIAL_HASH;
+    int threads = 0;
+    NeighborKernel kernel = KERNEL_SIMD;
+    int sortInterval = 0;
+    float skin = 0;
+    // world area treated as on screen for staggered updates, none by default
+    Rectangle view = {};
+    int slices = 1;
+    // 0 keeps the game's cellSize, visibleRadius; setting it stops tuning
+    float cellSize = 0;
+    // -1 keeps the game's cellSizeInterval
+    int cellSizeInterval = -1;
+    // 0 keeps the game's speeds
+    float minSpeed = 0;
+    float maxSpeed = 0;
+    // negative keeps the game's avoid, align and cohesion factors
+    float factors[3] = { -1, -1, -1 };
+    bool render = false;
+    // a file for loadObstacles, or this many random circles
+    const char *obstaclesPath = nullptr;
+    int randomObstacles = 0;
+    // separate turn, speed and move passes instead of the fused one
+    bool reference = false;
+    // boids selected, so the debug tagging runs every frame like in the game
+    int select = 0;
+    // fail when a timed frame makes more heap allocations than this
+    long long maxAllocations = -1;
+    // split the bounds into columns x rows tiles, each run by its own process
+    int tileColumns = 0;
+    int tileRows = 0;
+    // write every timed frame to a recording, or time drawing one instead of
+    // simulating
+    const char *recordPath = nullptr;
+    RecordingEncoding encoding = RECORDING_FLOAT;
+    const char *replayPath = nullptr;
+    // frame budget in seconds for a FrameGovernor, 0 for none
+    float budget = 0;
+    // per-frame SimTimings and SimCounters, written as CSV or JSON lines
+    const char *telemetryPath = nullptr;
+    bool telemetryJson = false;
+};
+
+static void usage(const char *name)
+{
+    printf("usage: %s [--count N] [--seed S] [--frames M] [--warmup K] [--dt seconds] [--bounds W H] [--grid] [--threads T] [--kernel entity|scalar|simd|aggregate] [--cell-size px] [--tune-cells steps] [--sort frames] [--skin px] [--speed min max] [--factors avoid align cohesion] [--view x y w h] [--slices N] [--obstacles file|--random-obstacles N] [--render] [--reference] [--select N] [--max-allocs N] [--tiles columns rows] [--record file [--quantize]|--replay file] [--budget ms] [--telemetry file.csv|--telemetry-json file.json]\n", name);
+}
+
+static bool parseArgs(int argc, char **argv, BenchOptions &options)
+{
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(arg, "--count") == 0 && hasValue) {
+            options.count = atoi(argv[++i]);
+        } else if (strcmp(arg, "--seed") == 0 && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(arg, "--frames") == 0 && hasValue) {
+            options.frames = atoi(argv[++i]);
+        } else if (strcmp(arg, "--warmup") == 0 && hasValue) {
+            options.warmup = atoi(argv[++i]);
+        } else if (strcmp(arg, "--dt") == 0 && hasValue) {
+            options.dt = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--bounds") == 0 && i + 2 < argc) {
+            options.width = float(atof(argv[++i]));
+            options.height = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--threads") == 0 && hasValue) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(arg, "--kernel") == 0 && hasValue) {
+            const char *kernel = argv[++i];
+            if (strcmp(kernel, "entity") == 0) {
+                options.kernel = KERNEL_ENTITY;
+            } else if (strcmp(kernel, "scalar") == 0) {
+                options.kernel = KERNEL_SCALAR;
+            } else if (strcmp(kernel, "simd") == 0) {
+                options.kernel = KERNEL_SIMD;
+            } else if (strcmp(kernel, "aggregate") == 0) {
+                options.kernel = KERNEL_AGGREGATE;
+            } else {
+                return false;
+            }
+        } else if (strcmp(arg, "--sort") == 0 && hasValue) {
+            options.sortInterval = atoi(argv[++i]);
+        } else if (strcmp(arg, "--speed") == 0 && i + 2 < argc) {
+            options.minSpeed = float(atof(argv[++i]));
+            options.maxSpeed = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--cell-size") == 0 && hasValue) {
+            options.cellSize = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--tune-cells") == 0 && hasValue) {
+            options.cellSizeInterval = atoi(argv[++i]);
+        } else if (strcmp(arg, "--view") == 0 && i + 4 < argc) {
+            options.view.x = float(atof(argv[++i]));
+            options.view.y = float(atof(argv[++i]));
+            options.view.width = float(atof(argv[++i]));
+            options.view.height = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--slices") == 0 && hasValue) {
+            options.slices = atoi(argv[++i]);
+        } else if (strcmp(arg, "--skin") == 0 && hasValue) {
+            options.skin = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--factors") == 0 && i + 3 < argc) {
+            for (float &factor : options.factors) {
+                factor = float(atof(argv[++i]));
+            }
+        } else if (strcmp(arg, "--obstacles") == 0 && hasValue) {
+            options.obstaclesPath = argv[++i];
+        } else if (strcmp(arg, "--random-obstacles") == 0 && hasValue) {
+            options.randomObstacles = atoi(argv[++i]);
+        } else if (strcmp(arg, "--render") == 0) {
+            options.render = true;
+        } else if (strcmp(arg, "--reference") == 0) {
+            options.reference = true;
+        } else if (strcmp(arg, "--select") == 0 && hasValue) {
+            options.select = atoi(argv[++i]);
+        } else if (strcmp(arg, "--max-allocs") == 0 && hasValue) {
+            options.maxAllocations = atoll(argv[++i]);
+        } else if (strcmp(arg, "--tiles") == 0 && i + 2 < argc) {
+            options.tileColumns = atoi(argv[++i]);
+            options.tileRows = atoi(argv[++i]);
+        } else if (strcmp(arg, "--record") == 0 && hasValue) {
+            options.recordPath = argv[++i];
+        } else if (strcmp(arg, "--quantize") == 0) {
+            options.encoding = RECORDING_QUANTIZED;
+        } else if (strcmp(arg, "--replay") == 0 && hasValue) {
+            options.replayPath = argv[++i];
+        } else if (strcmp(arg, "--budget") == 0 && hasValue) {
+            options.budget = float(atof(argv[++i])) / 1000.0f;
+        } else if (strcmp(arg, "--telemetry") == 0 && hasValue) {
+            options.telemetryPath = argv[++i];
+            options.telemetryJson = false;
+        } else if (strcmp(arg, "--telemetry-json") == 0 && hasValue) {
+            options.telemetryPath = argv[++i];
+            options.telemetryJson = true;
+        } else if (strcmp(arg, "--grid") == 0) {
+            options.spatialMode = SPATIAL_GRID;
+        } else {
+            return false;
+        }
+    }
+
+    return options.count > 0 && options.frames > 0 && options.warmup >= 0;
+}
+
+// the render path fed from a recording, the same input every run whatever
+// the simulation does; --frames loops over the recording
+static int runReplay(GameData &data, const BenchOptions &options)
+{
+    Replay replay;
+    auto openStart = std::chrono::steady_clock::now();
+    if (!openReplay(replay, options.replayPath) || replay.frameCount() == 0) {
+        fprintf(stderr, "could not replay %s\n", options.replayPath);
+        return 1;
+    }
+    double openSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - openStart).count();
+
+    data.pool.resize(options.threads);
+
+    Snapshot snapshot;
+    double decodeSeconds = 0;
+    double renderSeconds = 0;
+    uint64_t boidFrames = 0;
+    for (int i = 0; i < options.warmup + options.frames; i++) {
+        auto decodeStart = std::chrono::steady_clock::now();
+        replayFrame(replay, i % replay.frameCount(), data.pool, snapshot);
+        auto renderStart = std::chrono::steady_clock::now();
+        buildBoidVertices(snapshot, 0.5f, BOID_TRIANGLE, data.pool, data.boidVertices);
+        auto renderEnd = std::chrono::steady_clock::now();
+
+        if (i < options.warmup) continue;
+        decodeSeconds += std::chrono::duration<double>(renderStart - decodeStart).count();
+        renderSeconds += std::chrono::duration<double>(renderEnd - renderStart).count();
+        boidFrames += uint64_t(snapshot.count);
+    }
+
+    printf("replay: %s, %d frames, %.2f s simulated, %s, %.1f MB, opened in %.2f ms\n", options.replayPath, replay.frameCount(), replay.duration(),
+        replay.header->encoding == RECORDING_QUANTIZED ? "quantized" : "float", replay.size / 1e6, openSeconds * 1e3);
+    printf("%-10s %12s %16s\n", "system", "ms/frame", "ns/boid/frame");
+    printf("%-10s %12.3f %16.3f\n", "decode", decodeSeconds * 1e3 / options.frames, decodeSeconds * 1e9 / std::max<double>(1, double(boidFrames)));
+    printf("%-10s %12.3f %16.3f\n", "render", renderSeconds * 1e3 / options.frames, renderSeconds * 1e9 / std::max<double>(1, double(boidFrames)));
+
+    closeReplay(replay);
+    return 0;
+}
+
+// the same run split over worker processes, see TileCluster; only the
+// coordinator's view of it is timed, the per-tile split of a step comes from
+// the workers
+static int runTiles(GameData &data, const BenchOptions &options)
+{
+    TileCluster cluster;
+    auto startupStart = std::chrono::steady_clock::now();
+    if (!startTiles(cluster, data.config, data.obstacles, options.tileColumns, options.tileRows, options.dt, data.rng.next64())) {
+        fprintf(stderr, "could not start %dx%d tile workers\n", options.tileColumns, options.tileRows);
+        return 1;
+    }
+    double startup = std::chrono::duration<double>(std::chrono::steady_clock::now() - startupStart).count();
+
+    Snapshot snapshot;
+    for (int i = 0; i < options.warmup; i++) {
+        stepTiles(cluster);
+    }
+
+    int tiles = cluster.layout.count();
+    std::vector<double> tileSeconds(tiles, 0);
+    uint64_t exported = 0;
+    uint64_t migrated = 0;
+    double gatherSeconds = 0;
+    double renderSeconds = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.frames; i++) {
+        stepTiles(cluster);
+
+        for (int tile = 0; tile < tiles; tile++) {
+            TileStats stats = tileStats(cluster, tile);
+            tileSeconds[tile] += stats.stepSeconds;
+            exported += uint64_t(stats.exported);
+            migrated += uint64_t(stats.migrated);
+        }
+
+        if (options.render) {
+            auto gatherStart = std::chrono::steady_clock::now();
+            captureTiles(cluster, data.config, 0, data.pool, cluster.offsets, snapshot);
+            auto renderStart = std::chrono::steady_clock::now();
+            buildBoidVertices(snapshot, 0.5f, BOID_TRIANGLE, data.pool, data.boidVertices);
+            auto renderEnd = std::chrono::steady_clock::now();
+            gatherSeconds += std::chrono::duration<double>(renderStart - gatherStart).count();
+            renderSeconds += std::chrono::duration<double>(renderEnd - renderStart).count();
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // boids handed over in the last step are only in their old tile's exports
+    int owned = 0;
+    int inTransit = 0;
+    printf("boids: %d frames: %d dt: %f bounds: %.0fx%.0f index: %s tiles: %dx%d startup: %.1f ms\n", options.count, options.frames, options.dt, options.width, options.height,
+        options.spatialMode == SPATIAL_GRID ? "grid" : "hash", options.tileColumns, options.tileRows, startup * 1e3);
+    printf("%-6s %10s %12s\n", "tile", "boids", "step ms");
+    double slowest = 0;
+    double mean = 0;
+    for (int tile = 0; tile < tiles; tile++) {
+        TileStats stats = tileStats(cluster, tile);
+        owned += stats.owned;
+        inTransit += stats.migrated;
+        slowest = std::max(slowest, tileSeconds[tile]);
+        mean += tileSeconds[tile] / tiles;
+        printf("%-6d %10d %12.3f\n", tile, stats.owned, tileSeconds[tile] * 1e3 / options.frames);
+    }
+    printf("halo and migrants: %.1f exported, %.1f migrated per frame, imbalance %.2f (slowest / mean tile)\n",
+        double(exported) / options.frames, double(migrated) / options.frames, mean > 0 ? slowest / mean : 0.0);
+    if (options.render) {
+        printf("%-10s %12.3f ms/frame\n", "gather", gatherSeconds * 1e3 / options.frames);
+        printf("%-10s %12.3f ms/frame\n", "render", renderSeconds * 1e3 / options.frames);
+    }
+    printf("%-10s %12.3f ms/frame %10.3f ns/boid/frame\n", "total", elapsed * 1e3 / options.frames, elapsed * 1e9 / (double(options.count) * options.frames));
+
+    stopTiles(cluster);
+
+    if (owned + inTransit != options.count) {
+        fprintf(stderr, "tiles own %d boids and pass on %d, expected %d in all\n", owned, inTransit, options.count);
+        return 2;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    GameData data;
+    if (options.seed != 0) data.rng = Rng(options.seed);
+    data.config.count = options.count;
+    data.config.bounds = { 100, 100, options.width, options.height };
+    data.config.spatialMode = options.spatialMode;
+    data.config.threadCount = options.threads;
+    data.config.neighborKernel = options.kernel;
+    data.config.sortInterval = options.sortInterval;
+    data.config.neighborSkin = options.skin;
+    data.config.offscreenSlices = options.slices;
+    data.config.fusedIntegration = !options.reference;
+    data.view = options.view;
+    if (options.cellSize > 0) {
+        data.config.cellSize = options.cellSize;
+        data.config.cellSizeInterval = 0;
+    }
+    if (options.cellSizeInterval >= 0) {
+        data.config.cellSizeInterval = options.cellSizeInterval;
+    }
+    if (options.factors[0] >= 0) data.config.avoidFactor = options.factors[0];
+    if (options.factors[1] >= 0) data.config.alignFactor = options.factors[1];
+    if (options.factors[2] >= 0) data.config.cohesionFactor = options.factors[2];
+    if (options.maxSpeed > 0) {
+        data.config.minSpeed = options.minSpeed;
+        data.config.maxSpeed = options.maxSpeed;
+    }
+
+    if (options.obstaclesPath && !loadObstacles(options.obstaclesPath, data.obstacles)) {
+        fprintf(stderr, "could not load obstacles from %s\n", options.obstaclesPath);
+        return 1;
+    }
+    Rng obstacleRng(0x0b57);
+    for (int i = 0; i < options.randomObstacles; i++) {
+        Rectangle bounds = data.config.bounds;
+        Vector2 center = { obstacleRng.range(bounds.x, bounds.x + bounds.width), obstacleRng.range(bounds.y, bounds.y + bounds.height) };
+        data.obstacles.circles.push_back({ center, obstacleRng.range(5, 25) });
+    }
+    if (!data.obstacles.circles.empty() || !data.obstacles.polygons.empty()) {
+        auto buildStart = std::chrono::steady_clock::now();
+        buildObstacleField(data.obstacles, data.config.obstacleRange, data.config.obstacleCellSize);
+        printf("obstacles: %zu circles %zu polygons, field %dx%d (%.1f MB) built in %.1f ms\n", data.obstacles.circles.size(), data.obstacles.polygons.size(),
+            data.obstacles.columns, data.obstacles.rows, data.obstacles.memoryUsage() / 1e6,
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count() * 1e3);
+    }
+
+    if (options.replayPath) {
+        return runReplay(data, options);
+    }
+
+    if (options.tileColumns > 0 && options.tileRows > 0) {
+        return runTiles(data, options);
+    }
+
+    RecordingWriter recording;
+    Snapshot recorded;
+    if (options.recordPath && !openRecording(recording, options.recordPath, options.encoding, data.config)) {
+        fprintf(stderr, "can't open %s\n", options.recordPath);
+        return 1;
+    }
+
+    // like a click in the game, once the boids exist
+    auto selectBoids = [&]() {
+        if (options.select <= 0 || !data.reg.storage<Selected>().empty()) return;
+
+        const auto &boids = data.reg.storage<Boid>();
+        for (size_t b = 0; b < boids.size() && b < size_t(options.select); b++) {
+            data.reg.emplace<Selected>(boids.data()[b]);
+        }
+    };
+
+    SimTimings frame;
+    SimCounters counters;
+    Snapshot snapshot;
+    std::vector<entt::entity> visible;
+
+    // frames here are one step at --dt back to back, there is no sim rate
+    // for the governor to lower
+    FrameGovernor governor;
+    if (options.budget > 0) {
+        data.config.simRate = 0;
+        startGovernor(governor, data.config, options.budget);
+    }
+    GovernorScope governorScope = { options.render, options.view.width > 0 && options.view.height > 0 };
+
+    // the same work as a timed frame, so scratch buffers have grown to size
+    for (int i = 0; i < options.warmup; i++) {
+        step(data, options.dt, &frame, options.telemetryPath ? &counters : nullptr);
+        selectBoids();
+        markCandidates(data);
+        if (options.render) {
+            captureView(data, options.dt, 0, visible, snapshot);
+            buildBoidVertices(snapshot, 0.5f, BOID_TRIANGLE, data.pool, data.boidVertices);
+        }
+    }
+
+    FILE *telemetry = nullptr;
+    if (options.telemetryPath) {
+        telemetry = fopen(options.telemetryPath, "w");
+        if (!telemetry) {
+            fprintf(stderr, "can't open %s\n", options.telemetryPath);
+            return 1;
+        }
+        if (!options.telemetryJson) writeTelemetryCsvHeader(telemetry);
+    }
+
+    SimTimings total;
+    int framesOverBudget = 0;
+    double renderSeconds = 0;
+    double recordSeconds = 0;
+    uint64_t frameAllocations = 0;
+    uint64_t maxFrameAllocations = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.frames; i++) {
+        uint64_t allocationsBefore = allocationCount();
+        auto frameStart = std::chrono::steady_clock::now();
+
+        // counters only when asked for, gathering them costs a pass over the index
+        step(data, options.dt, &frame, telemetry ? &counters : nullptr);
+        selectBoids();
+        markCandidates(data);
+        for (int s = 0; s < SYSTEM_COUNT; s++) {
+            total.seconds[s] += frame.seconds[s];
+        }
+
+        if (telemetry) {
+            counters.governorLevel = governor.level;
+            if (options.telemetryJson) {
+                writeTelemetryJson(telemetry, i, frame, counters);
+            } else {
+                writeTelemetryCsv(telemetry, i, frame, counters);
+            }
+        }
+
+        if (options.render) {
+            auto renderStart = std::chrono::steady_clock::now();
+            captureView(data, options.dt, 0, visible, snapshot);
+            buildBoidVertices(snapshot, 0.5f, governorSquares(governor) ? BOID_SQUARE : BOID_TRIANGLE, data.pool, data.boidVertices);
+            renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+        }
+
+        if (governor.budget > 0) {
+            float work = std::chrono::duration<float>(std::chrono::steady_clock::now() - frameStart).count();
+            framesOverBudget += work > governor.budget;
+            if (updateGovernor(governor, data.config, governorScope, work, work)) {
+                applyGovernor(governor, data.config);
+                printf("frame %d: %s at %.2f ms a frame\n", i, governorLevelNames[governor.level], governor.frameSeconds * 1e3);
+            }
+        }
+
+        // outside the allocation count, the writer's buffers are its own
+        uint64_t allocations = allocationCount() - allocationsBefore;
+
+        if (recording.file) {
+            auto recordStart = std::chrono::steady_clock::now();
+            captureSnapshot(data.reg, data.config, options.dt, 0, data.pool, recorded);
+            recordSnapshot(recording, recorded, data.pool);
+            recordSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - recordStart).count();
+        }
+
+        frameAllocations += allocations;
+        maxFrameAllocations = std::max(maxFrameAllocations, allocations);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (telemetry) {
+        fclose(telemetry);
+    }
+
+    double boidFrames = double(options.count) * options.frames;
+
+    const char *kernelNames[] = { "entity", "scalar", neighborKernelName(), "aggregate" };
+    printf("boids: %d frames: %d dt: %f bounds: %.0fx%.0f index: %s kernel: %s threads: %d sort: %d skin: %g\n", options.count, options.frames, options.dt, options.width, options.height,
+        options.spatialMode == SPATIAL_GRID ? "grid" : "hash", options.spatialMode == SPATIAL_GRID ? kernelNames[options.kernel] : "entity", data.pool.size(), options.sortInterval, options.skin);
+    printf("%-10s %12s %16s\n", "system", "total ms", "ns/boid/frame");
+    for (int s = 0; s < SYSTEM_COUNT; s++) {
+        printf("%-10s %12.3f %16.3f\n", simSystemNames[s], total.seconds[s] * 1e3, total.seconds[s] * 1e9 / boidFrames);
+    }
+    if (options.render) {
+        printf("%-10s %12.3f %16.3f\n", "render", renderSeconds * 1e3, renderSeconds * 1e9 / boidFrames);
+    }
+    if (recording.file) {
+        printf("%-10s %12.3f %16.3f\n", "record", recordSeconds * 1e3, recordSeconds * 1e9 / boidFrames);
+        if (!closeRecording(recording)) {
+            fprintf(stderr, "could not finish writing %s\n", options.recordPath);
+            return 1;
+        }
+    }
+    printf("%-10s %12.3f %16.3f\n", "total", elapsed * 1e3, elapsed * 1e9 / boidFrames);
+
+    // to compare the end state of runs that should agree, e.g. --reference
+    double sumX = 0;
+    double sumY = 0;
+    double sumSpeed = 0;
+    for (auto [entity, position, velocity] : data.reg.view<const Position, const Velocity>().each()) {
+        sumX += position.p.x;
+        sumY += position.p.y;
+        sumSpeed += Vector2Length(velocity.v);
+    }
+    double boids = std::max<double>(1, double(data.reg.storage<Boid>().size()));
+    printf("cell size: %.2f, neighbor density %.6f\n", data.config.cellSize, data.cellSizeTuning.density);
+    printf("mean position: %.4f %.4f mean speed: %.4f integration: %s\n", sumX / boids, sumY / boids, sumSpeed / boids, options.reference ? "reference" : "fused");
+
+    if (governor.budget > 0) {
+        char line[160];
+        describeGovernor(governor, data.config, line, sizeof(line));
+        printf("governor: %s, %d frames over budget\n", line, framesOverBudget);
+    }
+
+    printf("allocations: %.1f per frame, at most %llu in one frame\n", double(frameAllocations) / options.frames, (unsigned long long)maxFrameAllocations);
+    if (options.maxAllocations >= 0 && maxFrameAllocations > uint64_t(options.maxAllocations)) {
+        fprintf(stderr, "a frame made %llu heap allocations, more than --max-allocs %lld\n", (unsigned long long)maxFrameAllocations, options.maxAllocations);
+        return 2;
+    }
+
+    return 0;
+}
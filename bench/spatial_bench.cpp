@@ -0,0 +1,388 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "rng.h"
+#include "spatial_hash.h"
+#include "uniform_grid.h"
+
+// Microbenchmarks for the spatial indexes on their own, without the rest
+// of the simulation. Every case is run --repeat times and the fastest run
+// is reported, one row per case and operation, as CSV or JSON so results
+// can be saved and diffed across commits.
+
+enum Distribution {
+    DIST_UNIFORM,     // spread evenly over the world
+    DIST_CLUSTERED,   // tight flocks of a few hundred boids
+    DIST_DEGENERATE,  // every boid in the same cell
+    DIST_COUNT,
+};
+
+static const char *distributionNames[DIST_COUNT] = { "uniform", "clustered", "degenerate" };
+
+enum IndexKind {
+    INDEX_HASH,
+    INDEX_GRID,
+    INDEX_COUNT,
+};
+
+static const char *indexNames[INDEX_COUNT] = { "hash", "grid" };
+
+struct SpatialBenchOptions {
+    std::vector<int> sizes = { 1000, 10000, 100000, 1000000 };
+    std::vector<float> ratios = { 0.5f, 1.0f, 2.0f };
+    bool distributions[DIST_COUNT] = { true, true, true };
+    bool indexes[INDEX_COUNT] = { true, true };
+    int repeat = 3;
+    int queries = 10000;
+    bool json = false;
+};
+
+// one row of output
+struct SpatialResult {
+    IndexKind index;
+    Distribution distribution;
+    int boids;
+    float ratio;
+    const char *operation;
+    int ops;
+    double seconds;
+    // candidates visited per query
+    double perQuery;
+    // sum of the visited entity ids, so the visits can't be optimized out
+    uint32_t checksum;
+};
+
+// the game's radii and density: 1200 boids over a 1080x520 box
+static const float benchVisibleRadius = 100.0f;
+static const float benchAvoidRadius = 40.0f;
+static const float benchDensity = 1200.0f / (1080.0f * 520.0f);
+static const int boidsPerCluster = 300;
+// how far a boid moves between two updates, one frame at top speed
+static const float benchStep = 1000.0f / 60.0f;
+
+static void usage(const char *name)
+{
+    printf("usage: %s [--sizes N,N,...] [--ratios R,R,...] [--dist uniform|clustered|degenerate,...] [--index hash|grid,...] [--repeat K] [--queries Q] [--json]\n", name);
+    printf("  ratios are cellSize / visibleRadius\n");
+}
+
+static bool parseList(const char *arg, std::vector<std::string> &out)
+{
+    out.clear();
+    std::string s = arg;
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t comma = s.find(',', start);
+        if (comma == std::string::npos) comma = s.size();
+        if (comma > start) out.push_back(s.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return !out.empty();
+}
+
+static bool parseNames(const char *arg, const char *const *names, int count, bool *enabled)
+{
+    std::vector<std::string> items;
+    if (!parseList(arg, items)) return false;
+
+    std::fill(enabled, enabled + count, false);
+    for (auto &item : items) {
+        int i = 0;
+        while (i < count && item != names[i]) i++;
+        if (i == count) return false;
+        enabled[i] = true;
+    }
+    return true;
+}
+
+static bool parseArgs(int argc, char **argv, SpatialBenchOptions &options)
+{
+    std::vector<std::string> items;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(arg, "--sizes") == 0 && hasValue) {
+            if (!parseList(argv[++i], items)) return false;
+            options.sizes.clear();
+            for (auto &item : items) options.sizes.push_back(atoi(item.c_str()));
+        } else if (strcmp(arg, "--ratios") == 0 && hasValue) {
+            if (!parseList(argv[++i], items)) return false;
+            options.ratios.clear();
+            for (auto &item : items) options.ratios.push_back(float(atof(item.c_str())));
+        } else if (strcmp(arg, "--dist") == 0 && hasValue) {
+            if (!parseNames(argv[++i], distributionNames, DIST_COUNT, options.distributions)) return false;
+        } else if (strcmp(arg, "--index") == 0 && hasValue) {
+            if (!parseNames(argv[++i], indexNames, INDEX_COUNT, options.indexes)) return false;
+        } else if (strcmp(arg, "--repeat") == 0 && hasValue) {
+            options.repeat = atoi(argv[++i]);
+        } else if (strcmp(arg, "--queries") == 0 && hasValue) {
+            options.queries = atoi(argv[++i]);
+        } else if (strcmp(arg, "--json") == 0) {
+            options.json = true;
+        } else {
+            return false;
+        }
+    }
+
+    for (int size : options.sizes) {
+        if (size <= 0) return false;
+    }
+    for (float ratio : options.ratios) {
+        if (ratio <= 0) return false;
+    }
+    return options.repeat > 0 && options.queries > 0;
+}
+
+// fills reg with count boids laid out by distribution inside config.bounds
+static void populate(entt::registry &reg, const Config &config, Distribution distribution, int count)
+{
+    Rng rng(0x5eed, uint64_t(distribution));
+    Rectangle b = config.bounds;
+
+    std::vector<Vector2> centers;
+    if (distribution == DIST_CLUSTERED) {
+        int clusters = std::max(1, count / boidsPerCluster);
+        for (int i = 0; i < clusters; i++) {
+            centers.push_back({ rng.range(b.x, b.x + b.width), rng.range(b.y, b.y + b.height) });
+        }
+    }
+
+    std::vector<entt::entity> entities(count);
+    reg.create(entities.begin(), entities.end());
+    reg.insert<Boid>(entities.begin(), entities.end());
+    reg.insert<Velocity>(entities.begin(), entities.end(), Velocity{ { 0, 0 } });
+
+    std::vector<Position> positions(count);
+    for (int i = 0; i < count; i++) {
+        Vector2 p;
+        switch (distribution) {
+        case DIST_UNIFORM:
+            p = { rng.range(b.x, b.x + b.width), rng.range(b.y, b.y + b.height) };
+            break;
+        case DIST_CLUSTERED: {
+            // flock about as wide as a boid can see
+            Vector2 c = centers[i % centers.size()];
+            float angle = rng.range(0, 2 * PI);
+            float distance = config.visibleRadius * sqrtf(rng.nextFloat());
+            p = { c.x + cosf(angle) * distance, c.y + sinf(angle) * distance };
+            break;
+        }
+        default: {
+            // the middle of one cell
+            float cx = (floorf((b.x + b.width / 2) / config.cellSize) + 0.5f) * config.cellSize;
+            float cy = (floorf((b.y + b.height / 2) / config.cellSize) + 0.5f) * config.cellSize;
+            float spread = config.cellSize * 0.25f;
+            p = { cx + rng.range(-spread, spread), cy + rng.range(-spread, spread) };
+            break;
+        }
+        }
+        positions[i] = { p };
+    }
+    reg.insert<Position>(entities.begin(), entities.end(), positions.begin());
+}
+
+// one frame of motion in a random direction for every boid, short enough
+// for the degenerate distribution to stay inside its cell
+static void jiggle(entt::registry &reg, const Config &config, Distribution distribution, Rng &rng)
+{
+    float step = distribution == DIST_DEGENERATE ? std::min(benchStep, config.cellSize * 0.2f) : benchStep;
+    for (auto [entity, position] : reg.view<Position>().each()) {
+        float angle = rng.range(0, 2 * PI);
+        position.p.x += cosf(angle) * step;
+        position.p.y += sinf(angle) * step;
+    }
+}
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// query points, sampled from the boids themselves so they land where boids are
+static std::vector<Position> queryPoints(entt::registry &reg, int queries)
+{
+    std::vector<Position> points;
+    const auto &storage = reg.storage<Position>();
+    Rng rng(0x9e3779b9);
+    for (int i = 0; i < queries; i++) {
+        points.push_back(storage.get(storage.data()[rng.next() % storage.size()]));
+    }
+    return points;
+}
+
+static void keepBest(SpatialResult &best, const SpatialResult &run)
+{
+    if (best.ops == 0 || run.seconds < best.seconds) best = run;
+}
+
+static void benchHash(const Config &config, Distribution distribution, int count, int queries, int repeat, std::vector<SpatialResult> &results)
+{
+    SpatialResult build = {}, update = {}, query = {}, removal = {};
+
+    for (int r = 0; r < repeat; r++) {
+        entt::registry reg;
+        populate(reg, config, distribution, count);
+        auto points = queryPoints(reg, queries);
+        auto view = reg.view<const Position>();
+        SpatialHash hash(&config);
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto [entity, position] : view.each()) {
+            hash.insert(entity, position);
+        }
+        keepBest(build, { INDEX_HASH, distribution, count, 0, "build", count, seconds(start), 0 });
+
+        Rng rng(0xd1ce, uint64_t(r));
+        jiggle(reg, config, distribution, rng);
+        start = std::chrono::steady_clock::now();
+        for (auto [entity, position] : view.each()) {
+            hash.insert(entity, position);
+        }
+        keepBest(update, { INDEX_HASH, distribution, count, 0, "update", count, seconds(start), 0 });
+
+        size_t found = 0;
+        uint32_t checksum = 0;
+        start = std::chrono::steady_clock::now();
+        for (auto &point : points) {
+            hash.forEachNear(point, [&](entt::entity e) {
+                checksum += uint32_t(e);
+                found++;
+            });
+        }
+        keepBest(query, { INDEX_HASH, distribution, count, 0, "query", queries, seconds(start), double(found) / queries, checksum });
+
+        start = std::chrono::steady_clock::now();
+        for (auto entity : view) {
+            hash.remove(entity);
+        }
+        keepBest(removal, { INDEX_HASH, distribution, count, 0, "remove", count, seconds(start), 0 });
+    }
+
+    results.insert(results.end(), { build, update, query, removal });
+}
+
+static void benchGrid(const Config &config, Distribution distribution, int count, int queries, int repeat, std::vector<SpatialResult> &results)
+{
+    SpatialResult build = {}, update = {}, query = {};
+
+    for (int r = 0; r < repeat; r++) {
+        entt::registry reg;
+        populate(reg, config, distribution, count);
+        auto points = queryPoints(reg, queries);
+        UniformGrid grid(&config);
+
+        auto start = std::chrono::steady_clock::now();
+        grid.rebuild(reg);
+        keepBest(build, { INDEX_GRID, distribution, count, 0, "build", count, seconds(start), 0 });
+
+        // the grid has no incremental path, an update is a rebuild over
+        // warm buffers
+        Rng rng(0xd1ce, uint64_t(r));
+        jiggle(reg, config, distribution, rng);
+        start = std::chrono::steady_clock::now();
+        grid.rebuild(reg);
+        keepBest(update, { INDEX_GRID, distribution, count, 0, "update", count, seconds(start), 0 });
+
+        size_t found = 0;
+        uint32_t checksum = 0;
+        start = std::chrono::steady_clock::now();
+        for (auto &point : points) {
+            grid.forEachNear(point, [&](entt::entity e) {
+                checksum += uint32_t(e);
+                found++;
+            });
+        }
+        keepBest(query, { INDEX_GRID, distribution, count, 0, "query", queries, seconds(start), double(found) / queries, checksum });
+    }
+
+    // removal is dropping the boid before the next rebuild, nothing to time
+    results.insert(results.end(), { build, update, query });
+}
+
+static void printCsvHeader()
+{
+    printf("index,distribution,boids,cell_ratio,operation,ops,total_ms,ns_per_op,per_query\n");
+}
+
+static void printCsv(const SpatialResult &r)
+{
+    printf("%s,%s,%d,%g,%s,%d,%.3f,%.3f,%.2f\n", indexNames[r.index], distributionNames[r.distribution], r.boids, r.ratio, r.operation, r.ops,
+        r.seconds * 1e3, r.seconds * 1e9 / r.ops, r.perQuery);
+}
+
+static void printJson(const std::vector<SpatialResult> &results)
+{
+    printf("[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const SpatialResult &r = results[i];
+        printf("  {\"index\": \"%s\", \"distribution\": \"%s\", \"boids\": %d, \"cell_ratio\": %g, \"operation\": \"%s\", \"ops\": %d, \"total_ms\": %.3f, \"ns_per_op\": %.3f, \"per_query\": %.2f}%s\n",
+            indexNames[r.index], distributionNames[r.distribution], r.boids, r.ratio, r.operation, r.ops,
+            r.seconds * 1e3, r.seconds * 1e9 / r.ops, r.perQuery, i + 1 < results.size() ? "," : "");
+    }
+    printf("]\n");
+}
+
+int main(int argc, char **argv)
+{
+    SpatialBenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!options.json) {
+        printCsvHeader();
+    }
+
+    std::vector<SpatialResult> results;
+    for (int count : options.sizes) {
+        // keep the game's density as the world grows
+        float side = sqrtf(count / benchDensity);
+        float aspect = 1080.0f / 520.0f;
+
+        for (float ratio : options.ratios) {
+            Config config = {};
+            config.bounds = { 0, 0, side * sqrtf(aspect), side / sqrtf(aspect) };
+            config.visibleRadius = benchVisibleRadius;
+            config.avoidRadius = benchAvoidRadius;
+            config.cellSize = benchVisibleRadius * ratio;
+
+            for (int d = 0; d < DIST_COUNT; d++) {
+                if (!options.distributions[d]) continue;
+
+                size_t first = results.size();
+                int queries = std::min(options.queries, count);
+                if (options.indexes[INDEX_HASH]) {
+                    benchHash(config, Distribution(d), count, queries, options.repeat, results);
+                }
+                if (options.indexes[INDEX_GRID]) {
+                    benchGrid(config, Distribution(d), count, queries, options.repeat, results);
+                }
+
+                for (size_t i = first; i < results.size(); i++) {
+                    results[i].ratio = ratio;
+                    if (!options.json) {
+                        printCsv(results[i]);
+                        fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+
+    if (options.json) {
+        printJson(results);
+    }
+
+    return 0;
+}
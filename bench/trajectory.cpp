@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "raymath.h"
+
+#include "neighbor_kernel.h"
+#include "recording.h"
+#include "sim.h"
+
+// Checks an optimized configuration against the reference simulation. Both
+// are spawned from the same seed and stepped side by side, and after every
+// step each boid of the variant is compared with the same boid of the
+// reference. Flocking is chaotic, rounding differences grow until the runs
+// have nothing in common within a few dozen steps, so by default the
+// reference state is copied into the variant after every comparison and
+// each step's error is measured on its own; --free lets the runs drift
+// apart, to see how long they stay close.
+//
+// The reference can also be a recording of an earlier reference run
+// (--save-golden, then --golden), to check a change against the tree it
+// started from. The reference never sorts or despawns, so boid i of a
+// recorded frame is entity i.
+
+struct TrajectoryOptions {
+    int count = 2000;
+    int steps = 300;
+    float dt = 1.0f / 60.0f;
+    float width = 1080;
+    float height = 520;
+    uint64_t seed = 1;
+    // 0 keeps the game's speeds
+    float minSpeed = 0;
+    float maxSpeed = 0;
+    int randomObstacles = 0;
+
+    // the variant, everything else as the reference runs it
+    SpatialMode spatialMode = SPATIAL_HASH;
+    NeighborKernel kernel = KERNEL_ENTITY;
+    int threads = 0;
+    bool fused = false;
+    float skin = 0;
+    int sortInterval = 0;
+    Rectangle view = {};
+    int slices = 1;
+    float cellSize = 0;
+    int cellSizeInterval = 0;
+    int neighborCap = 0;
+
+    // most any boid may be off its reference position, in world units;
+    // summing in another order moves boids by about a float ulp a step
+    float tolerance = 0.001f;
+    bool lockstep = true;
+    // print the error every this many steps, and on the first step over
+    int report = 50;
+    const char *goldenPath = nullptr;
+    const char *saveGoldenPath = nullptr;
+};
+
+static void usage(const char *name)
+{
+    printf("usage: %s [--count N] [--steps M] [--dt seconds] [--bounds W H] [--seed S] [--speed min max] [--random-obstacles N] "
+        "[--grid] [--kernel entity|scalar|simd|aggregate] [--threads T] [--fused] [--skin px] [--sort frames] [--view x y w h] [--slices N] "
+        "[--cell-size px] [--tune-cells steps] [--neighbor-cap N] [--tolerance px] [--free] [--report steps] [--golden file|--save-golden file]\n", name);
+}
+
+static bool parseArgs(int argc, char **argv, TrajectoryOptions &options)
+{
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(arg, "--count") == 0 && hasValue) {
+            options.count = atoi(argv[++i]);
+        } else if (strcmp(arg, "--steps") == 0 && hasValue) {
+            options.steps = atoi(argv[++i]);
+        } else if (strcmp(arg, "--dt") == 0 && hasValue) {
+            options.dt = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--bounds") == 0 && i + 2 < argc) {
+            options.width = float(atof(argv[++i]));
+            options.height = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--seed") == 0 && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(arg, "--speed") == 0 && i + 2 < argc) {
+            options.minSpeed = float(atof(argv[++i]));
+            options.maxSpeed = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--random-obstacles") == 0 && hasValue) {
+            options.randomObstacles = atoi(argv[++i]);
+        } else if (strcmp(arg, "--grid") == 0) {
+            options.spatialMode = SPATIAL_GRID;
+        } else if (strcmp(arg, "--kernel") == 0 && hasValue) {
+            const char *kernel = argv[++i];
+            if (strcmp(kernel, "entity") == 0) {
+                options.kernel = KERNEL_ENTITY;
+            } else if (strcmp(kernel, "scalar") == 0) {
+                options.kernel = KERNEL_SCALAR;
+            } else if (strcmp(kernel, "simd") == 0) {
+                options.kernel = KERNEL_SIMD;
+            } else if (strcmp(kernel, "aggregate") == 0) {
+                options.kernel = KERNEL_AGGREGATE;
+            } else {
+                return false;
+            }
+        } else if (strcmp(arg, "--threads") == 0 && hasValue) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(arg, "--fused") == 0) {
+            options.fused = true;
+        } else if (strcmp(arg, "--skin") == 0 && hasValue) {
+            options.skin = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--sort") == 0 && hasValue) {
+            options.sortInterval = atoi(argv[++i]);
+        } else if (strcmp(arg, "--view") == 0 && i + 4 < argc) {
+            options.view.x = float(atof(argv[++i]));
+            options.view.y = float(atof(argv[++i]));
+            options.view.width = float(atof(argv[++i]));
+            options.view.height = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--slices") == 0 && hasValue) {
+            options.slices = atoi(argv[++i]);
+        } else if (strcmp(arg, "--cell-size") == 0 && hasValue) {
+            options.cellSize = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--tune-cells") == 0 && hasValue) {
+            options.cellSizeInterval = atoi(argv[++i]);
+        } else if (strcmp(arg, "--neighbor-cap") == 0 && hasValue) {
+            options.neighborCap = atoi(argv[++i]);
+        } else if (strcmp(arg, "--tolerance") == 0 && hasValue) {
+            options.tolerance = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--free") == 0) {
+            options.lockstep = false;
+        } else if (strcmp(arg, "--report") == 0 && hasValue) {
+            options.report = atoi(argv[++i]);
+        } else if (strcmp(arg, "--golden") == 0 && hasValue) {
+            options.goldenPath = argv[++i];
+        } else if (strcmp(arg, "--save-golden") == 0 && hasValue) {
+            options.saveGoldenPath = argv[++i];
+        } else {
+            return false;
+        }
+    }
+
+    return options.count > 0 && options.steps > 0 && options.tolerance >= 0;
+}
+
+// the plainest path through the simulation: one thread, registry lookups
+// through the hash, separate integration passes, nothing skipped, capped or
+// tuned
+static void makeReference(Config &config)
+{
+    config.threadCount = 1;
+    config.spatialMode = SPATIAL_HASH;
+    config.neighborKernel = KERNEL_ENTITY;
+    config.cellSize = config.visibleRadius;
+    config.cellSizeInterval = 0;
+    config.neighborSkin = 0;
+    config.offscreenSlices = 1;
+    config.neighborCap = 0;
+    config.sortInterval = 0;
+    config.fusedIntegration = false;
+}
+
+static void makeVariant(const TrajectoryOptions &options, Config &config)
+{
+    config.threadCount = options.threads;
+    config.spatialMode = options.spatialMode;
+    config.neighborKernel = options.kernel;
+    if (options.cellSize > 0) config.cellSize = options.cellSize;
+    config.cellSizeInterval = options.cellSizeInterval;
+    config.neighborSkin = options.skin;
+    config.offscreenSlices = options.slices;
+    config.neighborCap = options.neighborCap;
+    config.sortInterval = options.sortInterval;
+    config.fusedIntegration = options.fused;
+}
+
+// how far the variant is off the reference after one step
+struct TrajectoryError {
+    float maxPosition = 0;
+    double meanPosition = 0;
+    float maxVelocity = 0;
+    // boids further off than the tolerance, and the furthest one
+    int over = 0;
+    int worst = -1;
+};
+
+static TrajectoryError compareBoids(const Snapshot &reference, const entt::registry &variant, float tolerance)
+{
+    TrajectoryError error;
+    const auto *positions = variant.storage<Position>();
+    const auto *velocities = variant.storage<Velocity>();
+
+    int compared = 0;
+    for (int i = 0; positions && velocities && i < reference.count; i++) {
+        entt::entity entity = entt::entity(i);
+        if (!positions->contains(entity)) continue;
+
+        float position = Vector2Distance(reference.positions[i], positions->get(entity).p);
+        float velocity = Vector2Distance(reference.velocities[i], velocities->get(entity).v);
+        // a NaN is as far off as it gets
+        if (std::isnan(position)) position = INFINITY;
+
+        if (position > error.maxPosition) {
+            error.maxPosition = position;
+            error.worst = i;
+        }
+        error.maxVelocity = std::max(error.maxVelocity, velocity);
+        error.meanPosition += position;
+        error.over += position > tolerance;
+        compared++;
+    }
+
+    if (compared < reference.count) {
+        // boids the variant lost count as infinitely far off
+        error.over += reference.count - compared;
+        error.maxPosition = INFINITY;
+    }
+    error.meanPosition /= std::max(compared, 1);
+    return error;
+}
+
+// put the variant's boids where the reference's are
+static void syncBoids(const Snapshot &reference, entt::registry &variant)
+{
+    auto &positions = variant.storage<Position>();
+    auto &lastPositions = variant.storage<LastPosition>();
+    auto &velocities = variant.storage<Velocity>();
+    for (int i = 0; i < reference.count; i++) {
+        entt::entity entity = entt::entity(i);
+        if (!positions.contains(entity)) continue;
+
+        positions.get(entity).p = reference.positions[i];
+        lastPositions.get(entity).p = reference.lastPositions[i];
+        velocities.get(entity).v = reference.velocities[i];
+    }
+}
+
+static const char *describeKernel(const Config &config)
+{
+    if (config.spatialMode != SPATIAL_GRID) return "hash entity";
+
+    switch (config.neighborKernel) {
+    case KERNEL_ENTITY: return "grid entity";
+    case KERNEL_SCALAR: return "grid scalar";
+    case KERNEL_SIMD: return neighborKernelName();
+    default: return "grid aggregate";
+    }
+}
+
+static void printConfig(const char *name, const Config &config, int threads)
+{
+    printf("%-10s %s, %s integration, %d threads, cell size %g%s, skin %g, slices %d, neighbor cap %d, sort %d\n", name, describeKernel(config),
+        config.fusedIntegration ? "fused" : "separate", threads, config.cellSize, config.cellSizeInterval > 0 ? " tuned" : "",
+        config.neighborSkin, config.offscreenSlices, config.neighborCap, config.sortInterval);
+}
+
+int main(int argc, char **argv)
+{
+    TrajectoryOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    GameData reference;
+    GameData variant;
+
+    Replay golden;
+    if (options.goldenPath) {
+        if (!openReplay(golden, options.goldenPath) || golden.frameCount() == 0) {
+            fprintf(stderr, "could not read %s\n", options.goldenPath);
+            return 1;
+        }
+        // the recording brings the world it was run in
+        reference.config = golden.header->config;
+        options.steps = std::min(options.steps, golden.frameCount());
+    } else {
+        reference.config.count = options.count;
+        reference.config.bounds = { 100, 100, options.width, options.height };
+        if (options.maxSpeed > 0) {
+            reference.config.minSpeed = options.minSpeed;
+            reference.config.maxSpeed = options.maxSpeed;
+        }
+        makeReference(reference.config);
+    }
+
+    variant.config = reference.config;
+    makeVariant(options, variant.config);
+    variant.view = options.view;
+
+    reference.rng = Rng(options.seed);
+    variant.rng = Rng(options.seed);
+
+    Rng obstacleRng(options.seed, 1);
+    for (int i = 0; i < options.randomObstacles; i++) {
+        Rectangle bounds = reference.config.bounds;
+        Vector2 center = { obstacleRng.range(bounds.x, bounds.x + bounds.width), obstacleRng.range(bounds.y, bounds.y + bounds.height) };
+        variant.obstacles.circles.push_back({ center, obstacleRng.range(5, 25) });
+    }
+    if (!variant.obstacles.circles.empty()) {
+        buildObstacleField(variant.obstacles, variant.config.obstacleRange, variant.config.obstacleCellSize);
+        reference.obstacles = variant.obstacles;
+    }
+
+    RecordingWriter recording;
+    if (options.saveGoldenPath && !openRecording(recording, options.saveGoldenPath, RECORDING_FLOAT, reference.config)) {
+        fprintf(stderr, "can't open %s\n", options.saveGoldenPath);
+        return 1;
+    }
+
+    printf("boids: %d steps: %d seed: %llu tolerance: %g%s\n", reference.config.count, options.steps, (unsigned long long)options.seed,
+        options.tolerance, options.lockstep ? " lockstep" : " free");
+    if (options.goldenPath) {
+        printf("%-10s %s, %d frames\n", "reference", options.goldenPath, golden.frameCount());
+    } else {
+        printConfig("reference", reference.config, 1);
+    }
+
+    Snapshot snapshot;
+    int firstOver = -1;
+    float worst = 0;
+    for (int i = 0; i < options.steps; i++) {
+        float dt = options.dt;
+        if (options.goldenPath) {
+            replayFrame(golden, i, reference.pool, snapshot);
+            dt = golden.frames[i]->dt;
+        } else {
+            step(reference, dt);
+            captureSnapshot(reference.reg, reference.config, dt, 0, reference.pool, snapshot);
+        }
+
+        step(variant, dt);
+        if (i == 0) {
+            printConfig("variant", variant.config, int(variant.pool.size()));
+        }
+
+        if (recording.file) {
+            recordSnapshot(recording, snapshot, reference.pool);
+        }
+
+        TrajectoryError error = compareBoids(snapshot, variant.reg, options.tolerance);
+        worst = std::max(worst, error.maxPosition);
+        bool over = error.over > 0;
+        bool report = options.report > 0 && (i + 1) % options.report == 0;
+        if (report || (over && firstOver < 0)) {
+            printf("step %5d: max %.6f mean %.6f, velocity max %.6f, %d over%s\n", i + 1, error.maxPosition, error.meanPosition,
+                error.maxVelocity, error.over, over && firstOver < 0 ? ", first step over" : "");
+        }
+        if (over && firstOver < 0) {
+            firstOver = i + 1;
+            if (error.worst >= 0) {
+                Vector2 expected = snapshot.positions[error.worst];
+                Vector2 actual = variant.reg.get<Position>(entt::entity(error.worst)).p;
+                printf("  boid %d at %.4f %.4f, reference %.4f %.4f\n", error.worst, actual.x, actual.y, expected.x, expected.y);
+            }
+        }
+
+        if (options.lockstep) {
+            syncBoids(snapshot, variant.reg);
+        }
+    }
+
+    if (recording.file && !closeRecording(recording)) {
+        fprintf(stderr, "could not finish writing %s\n", options.saveGoldenPath);
+        return 1;
+    }
+    closeReplay(golden);
+
+    if (firstOver >= 0) {
+        printf("off the reference from step %d, at most %.6f\n", firstOver, worst);
+        return 2;
+    }
+    printf("within %g of the reference for %d steps, at most %.6f\n", options.tolerance, options.steps, worst);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "raymath.h"
+
+#include "tracy/Tracy.hpp"
+
+#include "boid_renderer.h"
+
+void BoidRenderer::draw(const BoidVertices &vertices)
+{
+    ZoneScoped;
+
+    if (vertices.vertexCount == 0) return;
+
+    if (capacity == 0) {
+        material = LoadMaterialDefault();
+    }
+
+    if (vertices.vertexCount > capacity) {
+        if (mesh.vaoId != 0) {
+            UnloadMesh(mesh);
+        }
+
+        int newCapacity = capacity * 2 > vertices.vertexCount ? capacity * 2 : vertices.vertexCount;
+
+        mesh = {};
+        mesh.vertexCount = newCapacity;
+        mesh.triangleCount = newCapacity / 3;
+        mesh.vertices = (float *)MemAlloc(newCapacity * 3 * sizeof(float));
+        mesh.colors = (unsigned char *)MemAlloc(newCapacity * 4 * sizeof(unsigned char));
+        UploadMesh(&mesh, true);
+
+        capacity = newCapacity;
+    }
+
+    UpdateMeshBuffer(mesh, 0, vertices.positions.data(), vertices.vertexCount * 3 * sizeof(float), 0);
+    UpdateMeshBuffer(mesh, 3, vertices.colors.data(), vertices.vertexCount * 4 * sizeof(unsigned char), 0);
+
+    // only draw what was filled in this frame, the rest is spare capacity
+    Mesh visible = mesh;
+    visible.vertexCount = vertices.vertexCount;
+    visible.triangleCount = vertices.vertexCount / 3;
+    DrawMesh(visible, material, MatrixIdentity());
+}
+
+void BoidRenderer::unload()
+{
+    if (capacity == 0) return;
+
+    UnloadMesh(mesh);
+    UnloadMaterial(material);
+    mesh = {};
+    material = {};
+    capacity = 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "raylib.h"
+
+#include "boid_vertices.h"
+
+// GPU side of BoidVertices: one dynamic mesh that grows as needed and is
+// redrawn with a single DrawMesh call per frame
+struct BoidRenderer {
+    Mesh mesh = {};
+    Material material = {};
+    int capacity = 0;
+
+    void draw(const BoidVertices &vertices);
+    void unload();
+};
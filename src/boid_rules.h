@@ -0,0 +1,106 @@
+#pragma once
+
+#include <utility>
+
+#include "raylib.h"
+#include "raymath.h"
+
+#include "config.h"
+#include "neighbor_kernel.h"
+
+// Flocking rules as policy types. Each rule says whether the config turns
+// it on, which neighbor sums it reads and how it changes the velocity; the
+// logic passes are instantiated for the set of rules that are on, so a rule
+// with a zero factor costs nothing in the per-boid loops.
+//
+// A new behavior is a struct like these added to BoidRules below.
+
+struct Separation {
+    static constexpr bool needsClose = true;
+    static constexpr bool needsFlock = false;
+
+    static bool enabled(const Config &config) { return config.avoidFactor != 0; }
+
+    static Vector2 apply(Vector2 position, Vector2 velocity, const NeighborSums &sums, const Config &config)
+    {
+        return Vector2Add(velocity, Vector2Scale(sums.close, config.avoidFactor));
+    }
+};
+
+struct Alignment {
+    static constexpr bool needsClose = false;
+    static constexpr bool needsFlock = true;
+
+    static bool enabled(const Config &config) { return config.alignFactor != 0; }
+
+    static Vector2 apply(Vector2 position, Vector2 velocity, const NeighborSums &sums, const Config &config)
+    {
+        if (sums.count == 0) return velocity;
+
+        Vector2 avgVelocity = Vector2Divide(sums.velocity, Vector2{ float(sums.count), float(sums.count) });
+        return Vector2Add(velocity, Vector2Scale(Vector2Subtract(avgVelocity, velocity), config.alignFactor));
+    }
+};
+
+struct Cohesion {
+    static constexpr bool needsClose = false;
+    static constexpr bool needsFlock = true;
+
+    static bool enabled(const Config &config) { return config.cohesionFactor != 0; }
+
+    static Vector2 apply(Vector2 position, Vector2 velocity, const NeighborSums &sums, const Config &config)
+    {
+        if (sums.count == 0) return velocity;
+
+        Vector2 avgPosition = Vector2Divide(sums.position, Vector2{ float(sums.count), float(sums.count) });
+        return Vector2Add(velocity, Vector2Scale(Vector2Subtract(avgPosition, position), config.cohesionFactor));
+    }
+};
+
+// the active rules, applied in order
+template <typename... Rules>
+struct RuleSet {
+    // neighbors within avoidRadius, and the count, velocity and position
+    // sums of the ones within visibleRadius
+    static constexpr bool needsClose = (false || ... || Rules::needsClose);
+    static constexpr bool needsFlock = (false || ... || Rules::needsFlock);
+
+    static Vector2 steer(Vector2 position, Vector2 velocity, const NeighborSums &sums, const Config &config)
+    {
+        ((velocity = Rules::apply(position, velocity, sums, config)), ...);
+        return velocity;
+    }
+};
+
+// picks the enabled rules one at a time, instantiating every combination
+template <typename Active, typename... Rest>
+struct RuleDispatch;
+
+template <typename... Active>
+struct RuleDispatch<RuleSet<Active...>> {
+    template <typename Func>
+    static void run(const Config &config, Func &&func)
+    {
+        func(RuleSet<Active...>{});
+    }
+};
+
+template <typename... Active, typename Rule, typename... Rest>
+struct RuleDispatch<RuleSet<Active...>, Rule, Rest...> {
+    template <typename Func>
+    static void run(const Config &config, Func &&func)
+    {
+        if (Rule::enabled(config)) {
+            RuleDispatch<RuleSet<Active..., Rule>, Rest...>::run(config, std::forward<Func>(func));
+        } else {
+            RuleDispatch<RuleSet<Active...>, Rest...>::run(config, std::forward<Func>(func));
+        }
+    }
+};
+
+// every rule, in the order they apply
+template <typename Func>
+void withBoidRules(const Config &config, Func &&func)
+{
+    RuleDispatch<RuleSet<>, Separation, Alignment, Cohesion>::run(config, std::forward<Func>(func));
+}
@@ -0,0 +1,83 @@
+#include <cmath>
+
+#include "tracy/Tracy.hpp"
+
+#include "boid_vertices.h"
+
+static const float boidSize = 10;
+static const size_t vertexGrain = 4096;
+
+static void setColor(BoidVertices &vertices, size_t boid, Color c)
+{
+    unsigned char *out = vertices.colors.data() + boid * vertices.verticesPerBoid * 4;
+    for (int v = 0; v < vertices.verticesPerBoid; v++) {
+        out[v * 4 + 0] = c.r;
+        out[v * 4 + 1] = c.g;
+        out[v * 4 + 2] = c.b;
+        out[v * 4 + 3] = c.a;
+    }
+}
+
+void buildBoidVertices(const Snapshot &snapshot, float alpha, BoidShape shape, ThreadPool &pool, BoidVertices &vertices)
+{
+    ZoneScoped;
+
+    const Config &config = snapshot.config;
+
+    vertices.verticesPerBoid = shape == BOID_SQUARE ? 6 : 3;
+    vertices.vertexCount = snapshot.count * vertices.verticesPerBoid;
+    vertices.positions.resize(size_t(vertices.vertexCount) * 3);
+    vertices.colors.resize(size_t(vertices.vertexCount) * 4);
+
+    pool.parallelFor(size_t(snapshot.count), vertexGrain, [&](size_t begin, size_t end, int worker) {
+        for (size_t i = begin; i < end; i++) {
+            Vector2 last = snapshot.lastPositions[i];
+            Vector2 current = snapshot.positions[i];
+            Vector2 velocity = snapshot.velocities[i];
+            float *out = vertices.positions.data() + i * vertices.verticesPerBoid * 3;
+            float x = last.x + (current.x - last.x) * alpha;
+            float y = last.y + (current.y - last.y) * alpha;
+
+            if (shape == BOID_SQUARE) {
+                float half = boidSize / 2;
+                float corners[6][2] = {
+                    { x - half, y - half }, { x - half, y + half }, { x + half, y + half },
+                    { x - half, y - half }, { x + half, y + half }, { x + half, y - half },
+                };
+                for (int v = 0; v < 6; v++) {
+                    out[v * 3 + 0] = corners[v][0];
+                    out[v * 3 + 1] = corners[v][1];
+                    out[v * 3 + 2] = 0;
+                }
+            } else {
+                // forward and side axes straight from the normalized
+                // velocity, same shape as rotating by atan2 + PI / 2
+                float length = sqrtf(velocity.x * velocity.x + velocity.y * velocity.y);
+                float fx = length > 0 ? velocity.x / length : 1;
+                float fy = length > 0 ? velocity.y / length : 0;
+
+                float tip = boidSize * 2.0f;
+                float back = boidSize;
+                float side = boidSize * .8f;
+
+                out[0] = x + fx * tip;
+                out[1] = y + fy * tip;
+                out[2] = 0;
+                out[3] = x - fx * back + fy * side;
+                out[4] = y - fy * back - fx * side;
+                out[5] = 0;
+                out[6] = x - fx * back - fy * side;
+                out[7] = y - fy * back + fx * side;
+                out[8] = 0;
+            }
+
+            auto r = (unsigned int)floorf((velocity.x * 0.5f + config.maxSpeed) / (config.maxSpeed * 2) * 255);
+            auto g = (unsigned int)floorf((velocity.y * 0.5f + config.maxSpeed) / (config.maxSpeed * 2) * 255);
+            setColor(vertices, i, Color{ (unsigned char)r, (unsigned char)g, 255, 255 });
+        }
+    });
+
+    for (auto [index, color] : snapshot.highlights) {
+        setColor(vertices, index, color);
+    }
+}
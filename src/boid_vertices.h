@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+#include "raylib.h"
+
+#include "snapshot.h"
+#include "thread_pool.h"
+
+enum BoidShape {
+    BOID_TRIANGLE,  // pointing along the velocity
+    BOID_SQUARE,    // axis aligned, the cheap debug look
+};
+
+// CPU side vertex data for drawing every boid with one draw call.
+// Boid i of the snapshot owns vertices [i * verticesPerBoid, (i + 1) * verticesPerBoid).
+struct BoidVertices {
+    std::vector<float> positions;           // x, y, z per vertex
+    std::vector<unsigned char> colors;      // r, g, b, a per vertex
+    int verticesPerBoid = 3;
+    int vertexCount = 0;
+};
+
+// alpha blends each boid from its last position (0) to its position (1)
+void buildBoidVertices(const Snapshot &snapshot, float alpha, BoidShape shape, ThreadPool &pool, BoidVertices &vertices);
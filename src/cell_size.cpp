@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cmath>
+
+#include "tracy/Tracy.hpp"
+
+#include "cell_size.h"
+#include "sim.h"
+
+// most cells across the neighbor reach worth considering
+static const int maxCellDivisions = 6;
+// a new cell size has to be estimated this much cheaper to be worth the
+// rebuild, so noise in the density doesn't flip it back and forth
+static const float cellSizeHysteresis = 0.1f;
+
+// what each part of a query costs relative to one neighbor candidate, per
+// boid and step, from the ratios between bench runs over a range of
+// densities and cell sizes; only cell sizes for the same index and kernel
+// are ever compared, so the machine's absolute speed drops out
+struct QueryCosts {
+    // every boid the index offers as a neighbor candidate, 1
+    float perCandidate;
+    // every contiguous run of cells a grid query walks
+    float perRow;
+    // every cell the hash rewrites for a boid that moved to another cell
+    float perCellUpdate;
+    // every cell the grid clears and sums when it is rebuilt
+    float perGridCell;
+};
+
+static QueryCosts queryCosts(const Config &config)
+{
+    if (config.spatialMode == SPATIAL_HASH) return { 1.0f, 0.0f, 2.1f, 0.0f };
+
+    switch (config.neighborKernel) {
+    case KERNEL_ENTITY: return { 1.0f, 0.4f, 0.0f, 0.06f };
+    case KERNEL_SCALAR: return { 1.0f, 0.52f, 0.0f, 0.16f };
+    case KERNEL_SIMD: return { 1.0f, 86.0f, 0.0f, 3.6f };
+    // never tuned, see tuneCellSize; estimated as the SIMD kernel it walks
+    // the cells it can't take whole with
+    case KERNEL_AGGREGATE: return { 1.0f, 86.0f, 0.0f, 3.6f };
+    }
+    return { 1.0f, 0.0f, 0.0f, 0.0f };
+}
+
+void sizeCellSizeTuning(GameData &data)
+{
+    const Config &config = data.config;
+    if (config.spatialMode != SPATIAL_GRID || config.cellSizeInterval <= 0) return;
+
+    const UniformGrid &grid = data.grid;
+    size_t size = (size_t(grid.columns) + 1) * (size_t(grid.rows) + 1);
+    if (data.cellSizeTuning.sums.size() < size) data.cellSizeTuning.sums.resize(size);
+}
+
+float measureNeighborDensity(GameData &data)
+{
+    ZoneScoped;
+
+    const Config &config = data.config;
+
+    // the boids in the block of cells a query walks, from a summed area
+    // table of the cell counts; measured at the scale of a query, the
+    // clumping inside flocks and boids piled into the border cells count as
+    // much as they cost
+    if (config.spatialMode == SPATIAL_GRID) {
+        const UniformGrid &grid = data.grid;
+        int columns = grid.columns;
+        int rows = grid.rows;
+        if (columns == 0 || grid.cellSize <= 0) return 0;
+
+        // already sized along with the grid when tuning, see
+        // sizeCellSizeTuning; only the leading row and column aren't
+        // written below
+        std::vector<uint32_t> &sums = data.cellSizeTuning.sums;
+        size_t stride = size_t(columns) + 1;
+        if (sums.size() < stride * (rows + 1)) sums.resize(stride * (rows + 1));
+        std::fill(sums.begin(), sums.begin() + stride, 0);
+        for (int y = 1; y <= rows; y++) sums[y * stride] = 0;
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < columns; x++) {
+                sums[(y + 1) * stride + x + 1] = grid.cellCount[size_t(y) * columns + x]
+                    + sums[y * stride + x + 1] + sums[(y + 1) * stride + x] - sums[y * stride + x];
+            }
+        }
+
+        int radius = getSpatialRadius(&config);
+        double others = 0;
+        double boids = 0;
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < columns; x++) {
+                uint32_t occupancy = grid.cellCount[size_t(y) * columns + x];
+                if (occupancy == 0) continue;
+
+                int x0 = std::max(x - radius, 0);
+                int x1 = std::min(x + radius, columns - 1) + 1;
+                int y0 = std::max(y - radius, 0);
+                int y1 = std::min(y + radius, rows - 1) + 1;
+                uint32_t block = sums[y1 * stride + x1] - sums[y0 * stride + x1] - sums[y1 * stride + x0] + sums[y0 * stride + x0];
+                others += double(occupancy) * (block - 1);
+                boids += occupancy;
+            }
+        }
+
+        float span = (2 * radius + 1) * grid.cellSize;
+        return boids > 0 ? float(others / boids / (double(span) * span)) : 0;
+    }
+
+    // a hash cell holds every boid in the block of cells around it, so the
+    // cell a boid queries says how many others are in that block
+    const SpatialHash &hash = data.spatialHash;
+    double others = 0;
+    double boids = 0;
+    for (auto &[entity, home] : hash.homes) {
+        auto it = hash.hash.find(home.center);
+        if (it == hash.hash.end()) continue;
+
+        float span = (2 * home.radius + 1) * config.cellSize;
+        others += double(it->second.size() - 1) / (double(span) * span);
+        boids++;
+    }
+    return boids > 0 ? float(others / boids) : 0;
+}
+
+float estimateQueryCost(const Config &config, float cellSize, float density, size_t boids)
+{
+    Config trial = config;
+    trial.cellSize = cellSize;
+    int radius = getSpatialRadius(&trial);
+    float side = float(2 * radius + 1);
+    float span = side * cellSize;
+
+    QueryCosts costs = queryCosts(config);
+    float candidateCost = costs.perCandidate;
+    if (config.spatialMode == SPATIAL_HASH) {
+        // every boid sits in side * side cells' sets, the more copies there
+        // are the fewer of the ones visited are still in cache
+        candidateCost *= side / 3;
+    }
+    float cost = candidateCost * (1 + density * span * span);
+
+    if (config.spatialMode == SPATIAL_GRID) {
+        cost += costs.perRow * side;
+        float columns = config.bounds.width / cellSize + side;
+        float rows = config.bounds.height / cellSize + side;
+        cost += costs.perGridCell * columns * rows / float(std::max<size_t>(boids, 1));
+    } else {
+        // chance a boid crosses into another cell this step, at the speed
+        // most boids are held to
+        float stepSeconds = config.simRate > 0 ? 1.0f / config.simRate : 1.0f / 60.0f;
+        float crossings = std::min(1.0f, config.maxSpeed * stepSeconds * 4.0f / PI / cellSize);
+        cost += costs.perCellUpdate * 2 * side * side * crossings;
+    }
+
+    return cost;
+}
+
+float chooseCellSize(const Config &config, float density, size_t boids)
+{
+    // for a given number of cells across the reach the smallest cell that
+    // still covers it is the cheapest, fewer boids come along in the corners
+    float reach = getNeighborReach(&config);
+    float best = config.cellSize;
+    float bestCost = estimateQueryCost(config, best, density, boids);
+    for (int divisions = 1; divisions <= maxCellDivisions; divisions++) {
+        float cellSize = reach / divisions * 1.0001f;
+        float cost = estimateQueryCost(config, cellSize, density, boids);
+        if (cost < bestCost) {
+            best = cellSize;
+            bestCost = cost;
+        }
+    }
+    return best;
+}
+
+bool tuneCellSize(GameData &data)
+{
+    Config &config = data.config;
+    CellSizeTuning &tuning = data.cellSizeTuning;
+
+    // KERNEL_AGGREGATE wants cells well under visibleRadius, whatever the
+    // density
+    bool aggregate = config.spatialMode == SPATIAL_GRID && config.neighborKernel == KERNEL_AGGREGATE;
+    if (config.cellSizeInterval <= 0 || aggregate) return false;
+    if (++tuning.stepsSinceTuned < config.cellSizeInterval) return false;
+
+    ZoneScoped;
+
+    tuning.stepsSinceTuned = 0;
+    size_t boids = data.reg.storage<Boid>().size();
+    if (boids < 2) return false;
+
+    tuning.density = measureNeighborDensity(data);
+    tuning.estimatedCost = estimateQueryCost(config, config.cellSize, tuning.density, boids);
+
+    float cellSize = chooseCellSize(config, tuning.density, boids);
+    float cost = estimateQueryCost(config, cellSize, tuning.density, boids);
+    if (cost >= tuning.estimatedCost * (1 - cellSizeHysteresis)) return false;
+
+    config.cellSize = cellSize;
+    tuning.estimatedCost = cost;
+
+    // the hash keys its cells by size, start it over; the grid is rebuilt
+    // from scratch anyway
+    if (config.spatialMode == SPATIAL_HASH) {
+        data.spatialHash.clear();
+    }
+    updateSpatialHash(data);
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "config.h"
+
+struct GameData;
+
+// what the last cell size selection saw, kept between steps
+struct CellSizeTuning {
+    int stepsSinceTuned = 0;
+    // other boids per unit area around the average boid
+    float density = 0;
+    // estimated cost per boid and step at the current cell size, relative
+    // to visiting one neighbor candidate
+    float estimatedCost = 0;
+    // summed area table of the grid's cell counts
+    std::vector<uint32_t> sums;
+};
+
+// size cellSizeTuning.sums for the grid as last built, when tuning is on;
+// called whenever the grid is, so measuring never allocates
+void sizeCellSizeTuning(GameData &data);
+// other boids per unit area around each boid, averaged over boids, read
+// from the spatial index as last built; grid mode uses cellSizeTuning.sums
+// as scratch
+float measureNeighborDensity(GameData &data);
+// estimated cost per boid and step of neighbor queries and index upkeep
+// for the active index and kernel with cells cellSize wide, relative to
+// visiting one neighbor candidate
+float estimateQueryCost(const Config &config, float cellSize, float density, size_t boids);
+// the cell size with the lowest estimated cost
+float chooseCellSize(const Config &config, float density, size_t boids);
+// every config.cellSizeInterval steps, measure the density and move to a
+// clearly cheaper cell size if there is one, rebuilding the index; returns
+// true when it did
+bool tuneCellSize(GameData &data);
@@ -2,18 +2,71 @@
 
 #include "raylib.h"
 
+enum SpatialMode {
+    SPATIAL_HASH,   // SpatialHash, boids inserted into every cell around them
+    SPATIAL_GRID,   // UniformGrid, flat grid rebuilt every frame
+};
+
+enum NeighborKernel {
+    KERNEL_ENTITY,  // look up each neighbor's components in the registry
+    KERNEL_SCALAR,  // walk the grid's packed arrays one boid at a time
+    KERNEL_SIMD,    // walk the grid's packed arrays 4 or 8 boids at a time
+    KERNEL_AGGREGATE, // take cells wholly inside visibleRadius from per-cell
+                      // sums, needs a cellSize well under visibleRadius
+};
+
 struct Config {
     int count;
 
+    // threads used by the simulation including the main one, 0 for all cores
+    int threadCount;
+
+    // simulation steps per second, independent of the frame rate; 0 steps
+    // once per frame by however long the frame took
+    float simRate;
+
     Rectangle bounds;
+    // zero ties bounds to the window, otherwise bounds cover a world this
+    // big whatever the window size and the camera pans around it
+    Vector2 worldSize;
 
+    SpatialMode spatialMode;
+    // packed kernels need SPATIAL_GRID, the hash always uses KERNEL_ENTITY
+    NeighborKernel neighborKernel;
     float cellSize;
+    // steps between re-selecting cellSize for the measured density, see
+    // tuneCellSize; 0 keeps it as set
+    int cellSizeInterval;
+    // extra distance neighbor lists look, so they can be reused until a
+    // boid has moved half of it; 0 queries the spatial index every step
+    float neighborSkin;
+    // boids outside the view get their neighbor update once every this
+    // many steps, taking turns; 1 updates everyone every step
+    int offscreenSlices;
+    // boids stop taking in neighbors once this many are within
+    // visibleRadius, the nearest rows of grid cells first; 0 takes every
+    // neighbor. Not applied to neighbor lists or KERNEL_AGGREGATE
+    int neighborCap;
+    // frames between reordering boid storage so spatial neighbors are also
+    // memory neighbors, 0 disables
+    int sortInterval;
+    // edge turning, speed limits and movement in the same pass that commits
+    // the new velocity; false runs them as separate passes, the reference
+    // to validate against
+    bool fusedIntegration;
 
     float minSpeed;
     float maxSpeed;
 
     float turnFactor;
 
+    // boids closer than obstacleRange to an obstacle are pushed away by up
+    // to obstacleFactor a step, more the closer they are; the distance grid
+    // has a node every obstacleCellSize
+    float obstacleRange;
+    float obstacleCellSize;
+    float obstacleFactor;
+
     float avoidRadius;
     float avoidFactor;
     
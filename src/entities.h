@@ -17,6 +17,13 @@ struct Velocity
     Vector2 v;
 };
 
+// velocity being computed this frame, boidLogic reads Velocity and writes
+// here so boids can be updated in any order and on any thread
+struct NextVelocity
+{
+    Vector2 v;
+};
+
 struct BoidColor
 {
     Color color;
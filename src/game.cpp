@@ -1,266 +1,113 @@
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <thread>
+
 #include "raylib.h"
 #include "rlgl.h"
 #include "raymath.h"
 
 #include "tracy/Tracy.hpp"
 
+#include "boid_renderer.h"
 #include "game.h"
+#include "sim.h"
 
-float randf()
-{
-    return rand() / float(RAND_MAX);
-}
-
-float lerp(float lo, float hi, float amount)
-{
-    return amount * (hi - lo) + lo;
-}
-
-float randf_range(float lo, float hi)
-{
-    return lerp(lo, hi, randf());
-}
+static BoidRenderer boidRenderer;
 
-void spawnBoids(entt::registry &reg, const Config &config, SpatialHash &spatialHash)
+void buildBoids(GameData &data, const Snapshot &snapshot, float alpha)
 {
     ZoneScoped;
 
-    auto boids = reg.view<const Boid>();
-
-    if (boids.size() < config.count) {
-        for (int i = 0; config.count - boids.size(); i++) {
-            const auto entity = reg.create();
-            reg.emplace<Boid>(entity);
-            auto p = Vector2{ randf_range(config.bounds.x, config.bounds.width + config.bounds.x), randf_range(config.bounds.y, config.bounds.height + config.bounds.y) };
-            reg.emplace<Position>(entity, p);
-            reg.emplace<LastPosition>(entity, p);
-            reg.emplace<Velocity>(entity, Vector2{randf_range(-config.maxSpeed, config.maxSpeed), randf_range(-config.maxSpeed, config.maxSpeed)});
-            reg.emplace<BoidColor>(entity, Color{0, 255, 255, 255});
-
-            auto [position, velocity, lastPosition] = reg.get<Position, Velocity, LastPosition>(entity);
-            spatialHash.insert(entity, position, velocity, lastPosition, true);
-        }
-    }
-    else if (boids.size() > config.count) {
-        int toRemove = boids.size() - config.count;
-        std::vector<entt::entity> entities;
-        for (auto [entity] : boids.each()) {
-            spatialHash.remove(entity);
-            entities.push_back(entity);
-            toRemove--;
-            if (toRemove <= 0) break;
-        }
-
-        reg.destroy(entities.begin(), entities.end());
-    }
+    // inline, the simulation is idle while drawing and its pool is free
+    ThreadPool &pool = data.pipeline.threaded ? data.pipeline.renderPool : data.pool;
+    // squares skip the normalize triangles need, the governor's first resort
+    BoidShape shape = IsKeyDown(KEY_SPACE) || governorSquares(snapshot.governor) ? BOID_SQUARE : BOID_TRIANGLE;
+    buildBoidVertices(snapshot, alpha, shape, pool, data.boidVertices);
 }
 
-void updateTurnFactor(entt::registry &reg, Config &config)
+void drawDebugLines(const Snapshot &snapshot)
 {
     ZoneScoped;
-    
-    const auto boids = reg.view<Position, Velocity>();
-    for (auto [entity, position, velocity] : boids.each()) {
-        if (position.p.x < config.bounds.x) {
-            velocity.v.x += config.turnFactor;
-        } else if (position.p.x > config.bounds.width + config.bounds.x) {
-            velocity.v.x -= config.turnFactor;
-        }
 
-        if (position.p.y < config.bounds.y) {
-            velocity.v.y += config.turnFactor;
-        } else if (position.p.y > config.bounds.height + config.bounds.y) {
-            velocity.v.y -= config.turnFactor;
-        }
+    for (Vector2 position : snapshot.selected) {
+        DrawCircleLines(position.x, position.y, snapshot.config.avoidRadius, RED);
+        DrawCircleLines(position.x, position.y, snapshot.config.visibleRadius, YELLOW);
     }
 }
 
-void moveEntities(entt::registry &reg, float deltaTime)
+void readSelection(const GameData &data, SimInput &input)
 {
-    ZoneScoped;
-    
-    const auto boids = reg.view<Position, Velocity>();
-    for (auto [entity, position, velocity] : boids.each()) {
-        position.p = Vector2Add(position.p, Vector2Multiply(velocity.v, Vector2{deltaTime, deltaTime}));
-    }
-}
-
-void updateBoid(entt::registry &reg, const SpatialHash &spatialHash, const Config &config, entt::entity &entity)
-{
-    ZoneScoped;
-
-    auto [position, velocity] = reg.get<Position, Velocity>(entity);
-
-    int neighborCount = 0;
-    Vector2 close = {};
-    Vector2 avgVelocity = {};
-    Vector2 avgPosition = {};
-    for (auto& otherEntity : spatialHash.get_all_near_position(position)) {
-        if (entity == otherEntity) continue;
-
-        auto [otherPosition, otherVelocity] = reg.get<Position, Velocity>(otherEntity);
-
-        Vector2 distance = Vector2Subtract(position.p, otherPosition.p);
-        if (Vector2Length(distance) <= config.avoidRadius) {
-            close = Vector2Add(close, distance);
-        }
-
-        if (Vector2Length(distance) <= config.visibleRadius) {
-            neighborCount++;
-            avgVelocity = Vector2Add(avgVelocity, otherVelocity.v);
-            avgPosition = Vector2Add(avgPosition, otherPosition.p);
-
-            if (reg.all_of<Selected>(entity)) {
-                reg.emplace<Neighbor>(otherEntity);
-            }
-        }
-    }
-
-    velocity.v = Vector2Add(velocity.v, Vector2Multiply(close, Vector2{ config.avoidFactor, config.avoidFactor }));
-
-    if (neighborCount > 0) {
-        avgVelocity = Vector2Divide(avgVelocity, Vector2{ float(neighborCount), float(neighborCount) });
-        velocity.v = Vector2Add(velocity.v, Vector2Multiply(Vector2Subtract(avgVelocity, velocity.v), Vector2{ config.alignFactor, config.alignFactor }));
-
-        avgPosition = Vector2Divide(avgPosition, Vector2{ float(neighborCount), float(neighborCount) });
-        velocity.v = Vector2Add(velocity.v, Vector2Multiply(Vector2Subtract(avgPosition, position.p), Vector2{ config.cohesionFactor, config.cohesionFactor }));
+    if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) {
+        input.clearSelection = true;
     }
-}
-
-void boidLogic(entt::registry& reg, Config& config, const SpatialHash& spatialHash)
-{
-    ZoneScoped;
-
-    const auto boids = reg.view<Boid>();
-
-    reg.clear<Neighbor>();
 
-    for (auto [entity] : boids.each()) {
-        updateBoid(reg, spatialHash, config, entity);
+    if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
+        input.select = true;
+        input.selectAdditive = IsKeyDown(KEY_LEFT_SHIFT);
+        input.selectAt = GetScreenToWorld2D(GetMousePosition(), data.camera);
     }
 }
 
-void mustGoFaster(entt::registry &reg, Config &config, float delta)
+// from the snapshot's config alone, the index itself belongs to the
+// simulation and may be rebuilt at another cell size meanwhile; both
+// indexes line their cells up with multiples of cellSize
+void drawSpatialHashGrid(const Snapshot &snapshot)
 {
     ZoneScoped;
-    
-    const auto boids = reg.view<Boid, Velocity>();
-    for (auto [entity, velocity] : boids.each()) {
-        if (Vector2Length(velocity.v) < config.maxSpeed) {
-            velocity.v = Vector2Lerp(velocity.v, Vector2Multiply(Vector2Normalize(velocity.v), Vector2{ config.maxSpeed, config.maxSpeed }), delta);
-        }
 
-        if (Vector2Length(velocity.v) > config.maxSpeed) {
-            velocity.v = Vector2ClampValue(velocity.v, config.minSpeed, config.maxSpeed);
+    const Config &config = snapshot.config;
+    for (Vector2 p : snapshot.selected) {
+        float cellSize = config.cellSize;
+        cell home = { int(floorf(p.x / cellSize)), int(floorf(p.y / cellSize)) };
+        int radius = getSpatialRadius(&config);
+        for (int y = home.second - radius; y <= home.second + radius; y++) {
+            for (int x = home.first - radius; x <= home.first + radius; x++) {
+                DrawRectangleLines(int(floorf(x * cellSize)), int(floorf(y * cellSize)), int(cellSize), int(cellSize), RED);
+            }
         }
     }
 }
 
-void drawBoids(const entt::registry &reg, const Config &config)
+void drawObstacles(const ObstacleField &obstacles)
 {
     ZoneScoped;
 
-    const auto boids = reg.view<Boid, Position, Velocity, BoidColor>();
-
-    for (auto [entity, position, velocity, color] : boids.each()) {
-        
-        auto x = (unsigned int)floor((velocity.v.x * 0.5 + config.maxSpeed) / (config.maxSpeed * 2) * 255);
-        auto y = (unsigned int)floor((velocity.v.y * 0.5 + config.maxSpeed) / (config.maxSpeed * 2) * 255);
-
-        Color c = Color{ (unsigned char)x, (unsigned char)y, 255, 255 };
-        if (reg.all_of<Candidate>(entity)) {
-            c = GREEN;
-        }
-        if (reg.all_of<Neighbor>(entity)) {
-            c = RED;
-        }
-        if (reg.all_of<Selected>(entity)) {
-            c = BLUE;
-        }
-
-        if (IsKeyDown(KEY_SPACE)) {
-            auto size = Vector2{ 10, 10 };
-            auto halfSize = Vector2{ size.x / 2.0f, size.y / 2.0f };
-            DrawRectangleV(Vector2Subtract(position.p, halfSize), Vector2{ 10, 10 }, c);
-        }
-        else {
-            float rot = atan2f(velocity.v.y, velocity.v.x) + PI / 2;
-            float size = 10;
-            auto v1 = Vector2Add(position.p, Vector2Rotate({ 0, -size * 2.0f }, rot));
-            auto v2 = Vector2Add(position.p, Vector2Rotate({ -size * .8f, size }, rot));
-            auto v3 = Vector2Add(position.p, Vector2Rotate({ size * .8f, size }, rot));
-            DrawTriangle(v1, v2, v3, c);
-        }
+    for (auto &circle : obstacles.circles) {
+        DrawCircleLinesV(circle.center, circle.radius, ORANGE);
     }
-}
 
-void markCandidates(entt::registry &reg, const Config &config, const SpatialHash &spatialHash)
-{
-    ZoneScoped;
-
-    reg.clear<Candidate>();
-
-    auto selected = reg.view<Position, Selected>();
-    for (auto [entity, position] : selected.each()) {
-        for (auto &e : spatialHash.get_all_near_position(position)) {
-            if (e != entity) {
-                reg.emplace<Candidate>(e);
-            }
+    for (auto &polygon : obstacles.polygons) {
+        const auto &points = polygon.points;
+        for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+            DrawLineV(points[j], points[i], ORANGE);
         }
     }
 }
 
-void drawDebugLines(const entt::registry &reg, const Config &config)
+void drawBounds(const Config& config)
 {
     ZoneScoped;
 
-    auto selected = reg.view<Position, Selected>();
-    for (auto [entity, position] : selected.each()) {
-        DrawCircleLines(position.p.x, position.p.y, config.avoidRadius, RED);
-        DrawCircleLines(position.p.x, position.p.y, config.visibleRadius, YELLOW);
-    }
-}
-
-void selectBoid(entt::registry &reg, const Config &config, const Camera2D &camera, const SpatialHash &spatialHash)
-{
-    if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) {
-        reg.clear<Selected>();
-    }
-
-    if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-        Vector2 mouse = GetScreenToWorld2D(GetMousePosition(), camera);
-
-        if (!IsKeyDown(KEY_LEFT_SHIFT)) {
-            reg.clear<Selected>();
-        }
-
-        entt::entity minEntity = {};
-        float minDistance = FLT_MAX;
-        for (auto &entity : spatialHash.get_all_near_position({mouse})) {
-            auto position = reg.get<Position>(entity);
-
-            auto distance = Vector2Distance(position.p, mouse);
-            if (distance < minDistance) {
-                minDistance = distance;
-                minEntity = entity;
-            }
-        }
-
-        if (reg.valid(minEntity)) {
-            reg.emplace<Selected>(minEntity);
-        }
-    }
+    DrawRectangleLines(config.bounds.x, config.bounds.y, config.bounds.width, config.bounds.height, RED);
 }
 
-void drawBounds(const Config& config)
+void fitCameraToWorld(Config &config, Camera2D &camera)
 {
-    ZoneScoped;
+    config.bounds = { 0, 0, config.worldSize.x, config.worldSize.y };
 
-    DrawRectangleLines(config.bounds.x, config.bounds.y, config.bounds.width, config.bounds.height, RED);
+    float screenWidth = GetScreenWidth();
+    float screenHeight = GetScreenHeight();
+    camera.target = { config.worldSize.x / 2.0f, config.worldSize.y / 2.0f };
+    camera.offset = { screenWidth / 2.0f, screenHeight / 2.0f };
+    camera.zoom = fminf(screenWidth / config.worldSize.x, screenHeight / config.worldSize.y) * 0.9f;
 }
 
 void updateBounds(Config &config, Camera2D &camera)
 {
+    // the world doesn't follow the window, the camera pans over it instead
+    if (config.worldSize.x > 0 && config.worldSize.y > 0) return;
+
     int padding = 100;
     config.bounds.x = padding;
     config.bounds.y = padding;
@@ -272,21 +119,57 @@ void updateBounds(Config &config, Camera2D &camera)
     camera.offset = { config.bounds.width / 2.0f + padding, config.bounds.height / 2.0f + padding };
 }
 
-void updateZoom(Camera2D &camera)
+void updateZoom(Config &config, Camera2D &camera)
 {
+    bool largeWorld = config.worldSize.x > 0 && config.worldSize.y > 0;
+
     int mouseWheel = GetMouseWheelMove();
     if (mouseWheel != 0) {
-        float zoomAmount = 0.05;
-        float zoomMin = 0.01;
-        camera.zoom += zoomAmount * mouseWheel;
-        if (camera.zoom < zoomMin) camera.zoom = zoomMin;
+        if (largeWorld) {
+            // zoom spans orders of magnitude here, so step it by a ratio
+            // and keep the point under the mouse in place
+            Vector2 mouse = GetMousePosition();
+            Vector2 anchor = GetScreenToWorld2D(mouse, camera);
+            camera.offset = mouse;
+            camera.target = anchor;
+            camera.zoom *= powf(1.1f, float(mouseWheel));
+            if (camera.zoom < 1e-4f) camera.zoom = 1e-4f;
+        } else {
+            float zoomAmount = 0.05;
+            float zoomMin = 0.01;
+            camera.zoom += zoomAmount * mouseWheel;
+            if (camera.zoom < zoomMin) camera.zoom = zoomMin;
+        }
     }
 
     if (IsKeyPressed(KEY_EQUAL)) {
-        camera.zoom = 1;
+        if (largeWorld) {
+            fitCameraToWorld(config, camera);
+        } else {
+            camera.zoom = 1;
+        }
     }
 }
 
+// arrow keys or a middle mouse drag move the camera around a large world
+void updatePan(const Config &config, Camera2D &camera)
+{
+    if (config.worldSize.x <= 0 || config.worldSize.y <= 0) return;
+
+    if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
+        Vector2 delta = GetMouseDelta();
+        camera.target.x -= delta.x / camera.zoom;
+        camera.target.y -= delta.y / camera.zoom;
+    }
+
+    // half a screen a second whatever the zoom
+    float speed = GetScreenWidth() * 0.5f / camera.zoom * GetFrameTime();
+    if (IsKeyDown(KEY_LEFT)) camera.target.x -= speed;
+    if (IsKeyDown(KEY_RIGHT)) camera.target.x += speed;
+    if (IsKeyDown(KEY_UP)) camera.target.y -= speed;
+    if (IsKeyDown(KEY_DOWN)) camera.target.y += speed;
+}
+
 void drawDebugSelectedText(const entt::registry &reg, int startX, int startY, int fontSize)
 {
     char buf[120];
@@ -294,7 +177,7 @@ void drawDebugSelectedText(const entt::registry &reg, int startX, int startY, in
     auto selected = reg.view<Selected, Position>();
     Vector2 selectedPos = {};
     for (auto [entity, position] : selected.each()) {
-        sprintf_s(buf, "selected: %d (%0.2f, %0.2f)", entity, position.p.x, position.p.y);
+        snprintf(buf, sizeof(buf), "selected: %u (%0.2f, %0.2f)", unsigned(entt::to_integral(entity)), position.p.x, position.p.y);
         DrawText(buf, startX, startY, fontSize, Color{ 0, 255, 255, 255 });
         startY += fontSize;
         selectedPos = position.p;
@@ -302,7 +185,9 @@ void drawDebugSelectedText(const entt::registry &reg, int startX, int startY, in
 
     auto candidates = reg.view<Candidate, Position>();
 
-    std::vector<std::tuple<entt::entity, Position, float>> positions;
+    // kept between frames so drawing it doesn't allocate
+    static std::vector<std::tuple<entt::entity, Position, float>> positions;
+    positions.clear();
 
     for (auto [entity, position] : candidates.each()) {
         positions.push_back(std::tuple(entity, position, Vector2Distance(selectedPos, position.p)));
@@ -313,7 +198,7 @@ void drawDebugSelectedText(const entt::registry &reg, int startX, int startY, in
     });
 
     for (auto [entity, position, distance] : positions) {
-        sprintf_s(buf, "%d (%0.2f, %0.2f) distance: %0.2f", entity, position.p.x, position.p.y, distance);
+        snprintf(buf, sizeof(buf), "%u (%0.2f, %0.2f) distance: %0.2f", unsigned(entt::to_integral(entity)), position.p.x, position.p.y, distance);
 
         auto color = GREEN;
         if (reg.all_of<Neighbor>(entity)) color = RED;
@@ -323,7 +208,55 @@ void drawDebugSelectedText(const entt::registry &reg, int startX, int startY, in
     }
 }
 
-void draw(const GameData &data, const Config & config)
+// F3 overlay: what the last simulation step spent its time on and why
+void drawTelemetry(const Snapshot &snapshot, int startX, int startY, int fontSize)
+{
+    char buf[120];
+    Color color = { 0, 255, 255, 255 };
+
+    for (int s = 0; s < SYSTEM_COUNT; s++) {
+        snprintf(buf, sizeof(buf), "%-8s %7.3f ms", simSystemNames[s], snapshot.timings.seconds[s] * 1e3);
+        DrawText(buf, startX, startY, fontSize, color);
+        startY += fontSize;
+    }
+
+    const SimCounters &counters = snapshot.counters;
+    int boids = std::max(counters.boids, 1);
+    float ratio = counters.accepted > 0 ? float(counters.visited) / counters.accepted : 0;
+    snprintf(buf, sizeof(buf), "visited %.1f / boid, accepted %.1f / boid (%.1fx)",
+        float(counters.visited) / boids, float(counters.accepted) / boids, ratio);
+    DrawText(buf, startX, startY, fontSize, color);
+    startY += fontSize;
+
+    snprintf(buf, sizeof(buf), "cells touched %llu", (unsigned long long)counters.cellsTouched);
+    DrawText(buf, startX, startY, fontSize, color);
+    startY += fontSize;
+
+    snprintf(buf, sizeof(buf), "occupancy max %d mean %.1f over %d cells", counters.maxOccupancy, counters.meanOccupancy, counters.occupiedCells);
+    DrawText(buf, startX, startY, fontSize, color);
+    startY += fontSize;
+
+    snprintf(buf, sizeof(buf), "cell size %.1f%s", counters.cellSize, snapshot.config.cellSizeInterval > 0 ? ", tuned to the density" : "");
+    DrawText(buf, startX, startY, fontSize, color);
+    startY += fontSize;
+
+    if (counters.deferred > 0) {
+        snprintf(buf, sizeof(buf), "off screen, deferred %d (1 in %d updated)", counters.deferred, snapshot.config.offscreenSlices);
+        DrawText(buf, startX, startY, fontSize, color);
+        startY += fontSize;
+    }
+
+    if (snapshot.config.neighborKernel == KERNEL_AGGREGATE && snapshot.config.spatialMode == SPATIAL_GRID) {
+        snprintf(buf, sizeof(buf), "aggregate error %.2f%%", counters.aggregateError * 100);
+        DrawText(buf, startX, startY, fontSize, color);
+        startY += fontSize;
+    }
+
+    snprintf(buf, sizeof(buf), "index %.2f MiB%s", counters.indexBytes / (1024.0 * 1024.0), counters.neighborListBuilds ? ", neighbor lists rebuilt" : "");
+    DrawText(buf, startX, startY, fontSize, color);
+}
+
+void draw(const GameData &data, const Snapshot &snapshot)
 {
     ZoneScoped;
 
@@ -333,83 +266,181 @@ void draw(const GameData &data, const Config & config)
     BeginDrawing();
         ClearBackground(GRAY);
         BeginMode2D(data.camera);
-        drawBoids(data.reg, config);
-        drawSpatialHashGrid(data.reg, data.spatialHash);
-        drawDebugLines(data.reg, data.config);
-        drawBounds(data.config);
+        boidRenderer.draw(data.boidVertices);
+        drawSpatialHashGrid(snapshot);
+        drawDebugLines(snapshot);
+        drawObstacles(data.obstacles);
+        drawBounds(data.pipeline.frontConfig);
         EndMode2D();
 
         BeginMode2D(textCamera);
         char buf[80];
-        sprintf_s(buf, "boid count: %d", data.config.count);
+        if (snapshot.count < snapshot.total) {
+            snprintf(buf, sizeof(buf), "boid count: %d (%d in view)", snapshot.total, snapshot.count);
+        } else {
+            snprintf(buf, sizeof(buf), "boid count: %d", snapshot.total);
+        }
         DrawText(buf, 10, 10, 20, Color{ 0, 255, 255, 255 });
 
-        sprintf_s(buf, "fps: %d", GetFPS());
+        snprintf(buf, sizeof(buf), "fps: %d", GetFPS());
         DrawText(buf, 10, 30, 20, Color{ 0, 255, 255, 255 });
 
         int start = 50;
         int fontSize = 20;
 
+        if (snapshot.governor.budget > 0) {
+            char line[160];
+            describeGovernor(snapshot.governor, snapshot.config, line, sizeof(line));
+            DrawText(line, 10, start, fontSize, snapshot.governor.level > GOVERNOR_FULL ? ORANGE : Color{ 0, 255, 255, 255 });
+            start += fontSize;
+        }
+
+        if (data.pipeline.replay.frameCount() > 0) {
+            snprintf(buf, sizeof(buf), "replay frame %d / %d, %.2f s%s", data.pipeline.replayedFrame + 1, data.pipeline.replay.frameCount(),
+                data.pipeline.replayTime, data.pipeline.frontPaused ? ", paused" : "");
+            DrawText(buf, 10, start, fontSize, Color{ 0, 255, 255, 255 });
+            start += fontSize;
+        }
+
+        if (data.pipeline.frontTelemetry) {
+            drawTelemetry(snapshot, 10, start, fontSize);
+        }
+
         // drawDebugSelectedText(data.reg, 10, start, fontSize);
         EndMode2D();
     EndDrawing();
 }
 
-void updateSpatialHash(GameData & data)
+// the part of the world the camera shows
+Rectangle visibleWorld(const Camera2D &camera)
 {
-    ZoneScoped;
+    Vector2 topLeft = GetScreenToWorld2D({ 0, 0 }, camera);
+    Vector2 bottomRight = GetScreenToWorld2D({ float(GetScreenWidth()), float(GetScreenHeight()) }, camera);
+    return { topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y };
+}
 
-    auto boids = data.reg.view<const Boid, const Position, const Velocity, LastPosition>();
+void updatePause(Pipeline &pipeline)
+{
+    if (IsKeyPressed(KEY_SPACE)) {
+        pipeline.frontPaused = !pipeline.frontPaused;
+    }
 
-    for (auto [entity, p, v, l] : boids.each()) {
-        data.spatialHash.insert(entity, p, v, l);
-        // update the last position now that we've update the spatial
-        // so it can be used next frame
-        l.p = p.p;
+    if (IsKeyPressed(KEY_F3)) {
+        pipeline.frontTelemetry = !pipeline.frontTelemetry;
     }
 }
 
-void updatePause(GameData& data)
+// Play the loaded recording at the speed it was simulated, looping; space
+// pauses, comma and period step a frame back and forth, home restarts.
+// Returns how far to blend into the frame shown.
+float updateReplay(GameData &data)
 {
-    if (IsKeyPressed(KEY_SPACE)) {
-        data.paused = !data.paused;
+    ZoneScoped;
+
+    Pipeline &pipeline = data.pipeline;
+    const Replay &replay = pipeline.replay;
+
+    int frame = replay.frameAt(pipeline.replayTime);
+    if (IsKeyPressed(KEY_HOME)) {
+        pipeline.replayTime = 0;
+    } else if (IsKeyPressed(KEY_PERIOD) || IsKeyPressed(KEY_COMMA)) {
+        // land on the end of a step, where it has no blending to do
+        frame = std::clamp(frame + (IsKeyPressed(KEY_PERIOD) ? 1 : -1), 0, replay.frameCount() - 1);
+        pipeline.replayTime = replay.frames[frame]->time;
+        pipeline.frontPaused = true;
+    } else if (!pipeline.frontPaused) {
+        pipeline.replayTime += GetFrameTime();
+        if (pipeline.replayTime > replay.duration()) pipeline.replayTime = 0;
     }
+
+    frame = replay.frameAt(pipeline.replayTime);
+    if (frame != pipeline.replayedFrame) {
+        replayFrame(replay, frame, data.pool, pipeline.replayed);
+        pipeline.replayedFrame = frame;
+        pipeline.frontConfig.bounds = pipeline.replayed.config.bounds;
+    }
+
+    const Snapshot &snapshot = pipeline.replayed;
+    if (snapshot.dt <= 0) return 1;
+    return Clamp(1 - float(snapshot.time - pipeline.replayTime) / snapshot.dt, 0, 1);
 }
 
 int UpdateAndRender(GameData & data)
 {
     ZoneScoped;
 
-    float delta = GetFrameTime();
+    Pipeline &pipeline = data.pipeline;
 
-    updateBounds(data.config, data.camera);
-    updateZoom(data.camera);
-    updatePause(data);
+    if (pipeline.replay.frameCount() > 0) {
+        // the camera keeps the recording's coordinates, not the window's
+        updateZoom(pipeline.frontConfig, data.camera);
+        updatePan(pipeline.frontConfig, data.camera);
+        updatePause(pipeline);
 
-    spawnBoids(data.reg, data.config, data.spatialHash);
+        float alpha = updateReplay(data);
+        buildBoids(data, pipeline.replayed, alpha);
+        draw(data, pipeline.replayed);
+        return 0;
+    }
 
-    updateSpatialHash(data);
-    selectBoid(data.reg, data.config, data.camera, data.spatialHash);
-    markCandidates(data.reg, data.config, data.spatialHash);
+    updateBounds(pipeline.frontConfig, data.camera);
+    updateZoom(pipeline.frontConfig, data.camera);
+    updatePan(pipeline.frontConfig, data.camera);
+    updatePause(pipeline);
+
+    SimInput input = {};
+    input.bounds = pipeline.frontConfig.bounds;
+    input.paused = pipeline.frontPaused;
+    input.telemetry = pipeline.frontTelemetry;
+    input.view = visibleWorld(data.camera);
+    input.renderSeconds = pipeline.renderSeconds;
+    readSelection(data, input);
+    postInput(pipeline, input);
+
+    if (!pipeline.threaded) {
+        pipelineStep(data);
+    }
 
-    if (!data.paused) {
-        boidLogic(data.reg, data.config, data.spatialHash);
-        updateTurnFactor(data.reg, data.config);
-        mustGoFaster(data.reg, data.config, delta);
-        moveEntities(data.reg, delta);
+    pipeline.snapshots.acquire();
+    const Snapshot &snapshot = pipeline.snapshots.readBuffer();
+
+    // blend from the last step toward the newest one by how far the clock
+    // has moved past it; stepping inline once per frame there is nothing
+    // to blend toward
+    float alpha = 1;
+    bool interpolate = pipeline.threaded || snapshot.config.simRate > 0;
+    if (interpolate && snapshot.dt > 0) {
+        alpha = Clamp(float(pipelineClock() - snapshot.time) / snapshot.dt, 0, 1);
     }
 
+    auto renderStart = std::chrono::steady_clock::now();
+    buildBoids(data, snapshot, alpha);
+
     // Draw
     //----------------------------------------------------------------------------------
-    draw(data, data.config);
+    draw(data, snapshot);
     //----------------------------------------------------------------------------------
 
+    // for the governor, posted with the next frame's input
+    pipeline.renderSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - renderStart).count();
+
     return 0;
 }
 
-
 void ThreadWorker(GameData *data) {
-    _sleep(1000);
+    // no use stepping faster than anyone can watch
+    const auto minStep = std::chrono::microseconds(1000000 / 240);
 
-    data->config.count++;
-}
\ No newline at end of file
+    auto start = std::chrono::steady_clock::now();
+    float untilNext = pipelineStep(*data);
+    auto nextStep = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(untilNext));
+    std::this_thread::sleep_until(std::max(start + minStep, nextStep));
+}
+
+void Shutdown(GameData &data)
+{
+    stopTiles(data.pipeline.tiles);
+    closeRecording(data.pipeline.recording);
+    closeReplay(data.pipeline.replay);
+    boidRenderer.unload();
+}
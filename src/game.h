@@ -6,8 +6,16 @@
 
 #include "tracy/Tracy.hpp"
 
+#include "boid_vertices.h"
+#include "cell_size.h"
 #include "entities.h"
+#include "neighbor_list.h"
+#include "obstacles.h"
+#include "pipeline.h"
+#include "rng.h"
 #include "spatial_hash.h"
+#include "thread_pool.h"
+#include "uniform_grid.h"
 #include "config.h"
 
 struct GameData {
@@ -15,10 +23,30 @@ struct GameData {
     Camera2D camera;
     Config config;
     SpatialHash spatialHash;
+    UniformGrid grid;
+    ThreadPool pool;
+    Rng rng;
+    BoidVertices boidVertices;
+    NeighborLists neighborLists;
+    CellSizeTuning cellSizeTuning;
+    // static, loaded before the simulation starts and only read after
+    ObstacleField obstacles;
+    Pipeline pipeline;
+
+    // world space area on screen, empty when nothing is drawn
+    Rectangle view = {};
+    // the part of the world the spatial index is laid out over, all of
+    // config.bounds when empty; boids outside it still work, just slower
+    Rectangle indexArea = {};
+    uint64_t steps = 0;
 
     bool paused = false;
+    int framesSinceSort = 0;
+    std::vector<entt::entity> sortOrder;
+    std::vector<std::pair<uint32_t, entt::entity>> sortKeys;
+    std::vector<entt::entity> spawnScratch;
 
-    GameData() : spatialHash(&config) {
+    GameData() : spatialHash(&config), grid(&config) {
         camera = {
             {},
             {},
@@ -27,8 +55,11 @@ struct GameData {
         };
 
         config.bounds = { 100, 100, 1280 - 200, 720 - 200 };
+        config.worldSize = { 0, 0 };
 
         config.count = 1200;
+        config.threadCount = 0;
+        config.simRate = 60;
 
         config.minSpeed = 200.0f;
         config.maxSpeed = 1000.0f;
@@ -41,11 +72,25 @@ struct GameData {
         config.alignFactor = 0.05f;
         config.cohesionFactor = 0.0005f;
 
+        config.spatialMode = SPATIAL_HASH;
+        config.neighborKernel = KERNEL_SIMD;
         config.cellSize = config.visibleRadius;
+        config.cellSizeInterval = 0;
+        config.neighborSkin = 0;
+        config.offscreenSlices = 4;
+        config.neighborCap = 0;
+        config.sortInterval = 0;
+        config.fusedIntegration = true;
+        config.obstacleRange = 60.0f;
+        config.obstacleCellSize = 10.0f;
+        config.obstacleFactor = 100.0f;
     };
 };
 
 
 int Init(GameData &data);
 int UpdateAndRender(GameData &data);
-void ThreadWorker(GameData* data);
\ No newline at end of file
+void Shutdown(GameData &data);
+void ThreadWorker(GameData* data);
+// large-world mode: bounds cover config.worldSize and the camera shows all of it
+void fitCameraToWorld(Config &config, Camera2D &camera);
\ No newline at end of file
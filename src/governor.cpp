@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "governor.h"
+
+const char *governorLevelNames[GOVERNOR_LEVEL_COUNT] = {
+    "full",
+    "squares",
+    "stagger",
+    "stagger more",
+    "neighbor cap",
+    "tight neighbor cap",
+    "sim rate",
+    "low sim rate",
+};
+
+// seconds the frame time is smoothed over; a single long frame still moves
+// it most of the way, a stall is answered at once
+static const float smoothingSeconds = 0.25f;
+// seconds over budget before stepping down a level
+static const float overLimit = 0.1f;
+// seconds after a change before the next one, for the smoothed frame time
+// to show what the change did
+static const float settleSeconds = 0.5f;
+// stepping back needs frames this far under budget, so the level it steps
+// back to has some room
+static const float restoreFraction = 0.7f;
+static const float minRestoreDelay = 2.0f;
+static const float maxRestoreDelay = 30.0f;
+// over budget again this soon after stepping back counts as a bounce
+static const float bounceSeconds = 2.0f;
+
+// neighbors taken in under GOVERNOR_NEIGHBOR_CAP, half under the tight cap
+static const int cappedNeighbors = 32;
+// the sim rate is never lowered below this
+static const float minSimRate = 20.0f;
+
+// the knobs at a level, from the configured ones
+static void levelKnobs(const FrameGovernor &governor, int level, int &slices, int &cap, float &simRate)
+{
+    int baseSlices = std::max(governor.offscreenSlices, 1);
+    slices = governor.offscreenSlices;
+    if (level >= GOVERNOR_STAGGER) slices = baseSlices * 2;
+    if (level >= GOVERNOR_STAGGER_MORE) slices = baseSlices * 4;
+
+    cap = governor.neighborCap;
+    int limit = 0;
+    if (level >= GOVERNOR_NEIGHBOR_CAP) limit = cappedNeighbors;
+    if (level >= GOVERNOR_NEIGHBOR_CAP_TIGHT) limit = cappedNeighbors / 2;
+    if (limit > 0) cap = cap > 0 ? std::min(cap, limit) : limit;
+
+    simRate = governor.simRate;
+    if (simRate > minSimRate) {
+        if (level >= GOVERNOR_SIM_RATE) simRate = std::max(governor.simRate * 0.75f, minSimRate);
+        if (level >= GOVERNOR_SIM_RATE_LOW) simRate = std::max(governor.simRate * 0.5f, minSimRate);
+    }
+}
+
+// whether stepping from level - 1 to level changes anything in this run
+static bool levelChangesAnything(const FrameGovernor &governor, const Config &config, const GovernorScope &scope, int level)
+{
+    int slices, cap;
+    float simRate;
+    int lastSlices, lastCap;
+    float lastSimRate;
+    levelKnobs(governor, level, slices, cap, simRate);
+    levelKnobs(governor, level - 1, lastSlices, lastCap, lastSimRate);
+
+    switch (level) {
+    case GOVERNOR_SQUARES:
+        return scope.rendering;
+    case GOVERNOR_STAGGER:
+    case GOVERNOR_STAGGER_MORE:
+        return scope.offscreen && slices != lastSlices;
+    case GOVERNOR_NEIGHBOR_CAP:
+    case GOVERNOR_NEIGHBOR_CAP_TIGHT: {
+        // neighbor lists and cell aggregates aren't capped
+        bool aggregate = config.spatialMode == SPATIAL_GRID && config.neighborKernel == KERNEL_AGGREGATE;
+        return config.neighborSkin <= 0 && !aggregate && cap != lastCap;
+    }
+    case GOVERNOR_SIM_RATE:
+    case GOVERNOR_SIM_RATE_LOW:
+        return simRate != lastSimRate;
+    default:
+        return false;
+    }
+}
+
+void startGovernor(FrameGovernor &governor, const Config &config, float budget)
+{
+    governor = {};
+    governor.budget = budget;
+    governor.offscreenSlices = config.offscreenSlices;
+    governor.neighborCap = config.neighborCap;
+    governor.simRate = config.simRate;
+    governor.restoreDelay = minRestoreDelay;
+    // nothing to wait for before the first change
+    governor.sinceChange = settleSeconds;
+}
+
+bool updateGovernor(FrameGovernor &governor, const Config &config, const GovernorScope &scope, float workSeconds, float elapsed)
+{
+    if (governor.budget <= 0) return false;
+
+    governor.scope = scope;
+    if (governor.frameSeconds == 0) {
+        governor.frameSeconds = workSeconds;
+    } else {
+        float weight = 1 - expf(-elapsed / smoothingSeconds);
+        governor.frameSeconds += (workSeconds - governor.frameSeconds) * weight;
+    }
+    governor.sinceChange += elapsed;
+
+    if (governor.frameSeconds > governor.budget) {
+        governor.overSeconds += elapsed;
+        governor.underSeconds = 0;
+    } else if (governor.frameSeconds < governor.budget * restoreFraction) {
+        governor.underSeconds += elapsed;
+        governor.overSeconds = 0;
+    } else {
+        governor.overSeconds = 0;
+        governor.underSeconds = 0;
+    }
+
+    if (governor.sinceChange < settleSeconds) return false;
+
+    int level = governor.level;
+    if (governor.overSeconds >= overLimit) {
+        // the first level up that gives anything up, or stay if none does
+        int next = level + 1;
+        while (next < GOVERNOR_LEVEL_COUNT && !levelChangesAnything(governor, config, scope, next)) next++;
+        if (next >= GOVERNOR_LEVEL_COUNT) return false;
+
+        if (governor.restored && governor.sinceChange < bounceSeconds) {
+            governor.restoreDelay = std::min(governor.restoreDelay * 2, maxRestoreDelay);
+        }
+        governor.restored = false;
+        level = next;
+    } else if (governor.underSeconds >= governor.restoreDelay && level > GOVERNOR_FULL) {
+        // levels that changed nothing are the same as the one below them
+        int previous = level - 1;
+        while (previous > GOVERNOR_FULL && !levelChangesAnything(governor, config, scope, previous)) previous--;
+
+        governor.restored = true;
+        level = previous;
+    } else {
+        return false;
+    }
+
+    governor.level = level;
+    governor.changes++;
+    governor.sinceChange = 0;
+    governor.overSeconds = 0;
+    governor.underSeconds = 0;
+    return true;
+}
+
+void applyGovernor(const FrameGovernor &governor, Config &config)
+{
+    if (governor.budget <= 0) return;
+
+    levelKnobs(governor, governor.level, config.offscreenSlices, config.neighborCap, config.simRate);
+}
+
+bool governorSquares(const FrameGovernor &governor)
+{
+    return governor.budget > 0 && governor.level >= GOVERNOR_SQUARES;
+}
+
+void describeGovernor(const FrameGovernor &governor, const Config &config, char *buf, size_t size)
+{
+    int written = snprintf(buf, size, "budget %.1f ms, frame %.1f ms:", governor.budget * 1e3, governor.frameSeconds * 1e3);
+    auto append = [&](const char *format, auto... args) {
+        if (written < 0 || size_t(written) >= size) return;
+        written += snprintf(buf + written, size - written, format, args...);
+    };
+
+    if (governor.level == GOVERNOR_FULL) append(" full fidelity");
+    // knobs out of scope are set all the same but change nothing
+    if (governorSquares(governor) && governor.scope.rendering) append(" squares,");
+    if (config.offscreenSlices != governor.offscreenSlices && governor.scope.offscreen) append(" off screen 1 in %d,", config.offscreenSlices);
+    if (config.neighborCap != governor.neighborCap) append(" %d neighbors,", config.neighborCap);
+    if (config.simRate != governor.simRate) append(" %.0f Hz,", config.simRate);
+    append(" %d changes", governor.changes);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+
+#include "config.h"
+
+// Steps the governor takes away from the configured fidelity, the least
+// noticeable first. Each level keeps everything the ones before it gave up.
+enum GovernorLevel {
+    GOVERNOR_FULL,          // as configured
+    GOVERNOR_SQUARES,       // boids drawn as squares, no normalize per boid
+    GOVERNOR_STAGGER,       // off screen boids updated half as often
+    GOVERNOR_STAGGER_MORE,  // a quarter as often
+    GOVERNOR_NEIGHBOR_CAP,  // boids take in their nearest neighbors only
+    GOVERNOR_NEIGHBOR_CAP_TIGHT, // half as many
+    GOVERNOR_SIM_RATE,      // three quarters of the sim rate
+    GOVERNOR_SIM_RATE_LOW,  // half of it
+    GOVERNOR_LEVEL_COUNT,
+};
+
+extern const char *governorLevelNames[GOVERNOR_LEVEL_COUNT];
+
+// which knobs would change anything in this run
+struct GovernorScope {
+    // something draws the boids
+    bool rendering;
+    // part of the world is off screen
+    bool offscreen;
+};
+
+// Holds frames within a time budget by giving up fidelity instead of frame
+// rate: over budget it steps to the next level that changes anything in
+// this run, well under budget for a while it steps back.
+struct FrameGovernor {
+    // seconds of work a frame may take, 0 leaves the config alone
+    float budget = 0;
+
+    // the knobs as configured, what each level is relative to
+    int offscreenSlices = 1;
+    int neighborCap = 0;
+    float simRate = 0;
+
+    int level = GOVERNOR_FULL;
+    // as of the last update
+    GovernorScope scope = {};
+    // seconds of work per frame, smoothed
+    float frameSeconds = 0;
+    // seconds spent over budget, or well under it, without a break
+    float overSeconds = 0;
+    float underSeconds = 0;
+    // seconds since the level last changed
+    float sinceChange = 0;
+    // how long it has to stay well under budget to step back; doubles every
+    // time stepping back put it straight over budget again
+    float restoreDelay = 0;
+    bool restored = false;
+    int changes = 0;
+};
+
+void startGovernor(FrameGovernor &governor, const Config &config, float budget);
+// feed the work one frame took and the wall time it covered; returns true
+// when the level changed and applyGovernor has something new to apply
+bool updateGovernor(FrameGovernor &governor, const Config &config, const GovernorScope &scope, float workSeconds, float elapsed);
+// set the knobs in config to what the current level allows
+void applyGovernor(const FrameGovernor &governor, Config &config);
+// boids drawn as squares rather than triangles
+bool governorSquares(const FrameGovernor &governor);
+// one line saying what the governor gave up to hold the budget
+void describeGovernor(const FrameGovernor &governor, const Config &config, char *buf, size_t size);
@@ -7,9 +7,19 @@
 
 #include "tracy/Tracy.hpp"
 
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <random>
+#include <thread>
 
-bool running = true;
+std::atomic<bool> running = true;
+
+static void usage(const char *name)
+{
+    std::cerr << "usage: " << name << " [--pipelined] [--sim-rate N] [--world W H] [--count N] [--obstacles file] [--record file [--quantize]|--replay file] [--seed N] [--budget ms] [--tune-cells N] [--tiles C R]" << std::endl;
+}
 
 void ThreadProc(GameData *data) {
     while (running) {
@@ -20,7 +30,7 @@ void ThreadProc(GameData *data) {
 //------------------------------------------------------------------------------------
 // Program main entry point
 //------------------------------------------------------------------------------------
-int main ()
+int main (int argc, char **argv)
 {
     // Initialization
     //--------------------------------------------------------------------------------------
@@ -36,17 +46,115 @@ int main ()
 
     GameData data;
 
-    srand(time_t(NULL));
-    /*
-    std::thread t0(ThreadProc, &data);
-    std::thread t1(ThreadProc, &data);
-    std::thread t2(ThreadProc, &data);
-    std::thread t3(ThreadProc, &data);
-    std::thread t4(ThreadProc, &data);
-    std::thread t5(ThreadProc, &data);
-    std::thread t6(ThreadProc, &data);
-    std::thread t7(ThreadProc, &data);
-    */
+    // --pipelined runs the simulation on its own thread, one step ahead of drawing
+    // --sim-rate N steps the simulation N times a second, 0 once per frame
+    // --world W H simulates a W x H world independent of the window
+    // --count N sets the number of boids
+    // --obstacles file loads static obstacles, see loadObstacles
+    // --record file writes every step to a recording, --quantize at half the size
+    // --replay file plays a recording back instead of simulating
+    // --seed N spawns the same boids as another run with that seed
+    // --budget ms gives up fidelity to keep frames under ms, see FrameGovernor
+    // --tune-cells N re-selects the cell size for the density every N steps
+    // --tiles C R splits the world into C x R tiles, each simulated by its own process
+    bool pipelined = false;
+    const char *obstaclesPath = nullptr;
+    const char *recordPath = nullptr;
+    const char *replayPath = nullptr;
+    RecordingEncoding encoding = RECORDING_FLOAT;
+    float budget = 0;
+    int tileColumns = 0;
+    int tileRows = 0;
+    // a different flock every run unless asked for a particular one
+    uint64_t seed = std::random_device()();
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--pipelined") == 0) {
+            pipelined = true;
+        } else if (strcmp(arg, "--sim-rate") == 0 && hasValue) {
+            data.config.simRate = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--count") == 0 && hasValue) {
+            data.config.count = atoi(argv[++i]);
+        } else if (strcmp(arg, "--obstacles") == 0 && hasValue) {
+            obstaclesPath = argv[++i];
+        } else if (strcmp(arg, "--record") == 0 && hasValue) {
+            recordPath = argv[++i];
+        } else if (strcmp(arg, "--quantize") == 0) {
+            encoding = RECORDING_QUANTIZED;
+        } else if (strcmp(arg, "--replay") == 0 && hasValue) {
+            replayPath = argv[++i];
+        } else if (strcmp(arg, "--seed") == 0 && hasValue) {
+            seed = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(arg, "--budget") == 0 && hasValue) {
+            budget = float(atof(argv[++i])) / 1000.0f;
+        } else if (strcmp(arg, "--tune-cells") == 0 && hasValue) {
+            data.config.cellSizeInterval = atoi(argv[++i]);
+        } else if (strcmp(arg, "--tiles") == 0 && i + 2 < argc) {
+            tileColumns = atoi(argv[++i]);
+            tileRows = atoi(argv[++i]);
+        } else if (strcmp(arg, "--world") == 0 && i + 2 < argc) {
+            data.config.worldSize.x = float(atof(argv[++i]));
+            data.config.worldSize.y = float(atof(argv[++i]));
+        } else {
+            usage(argv[0]);
+            CloseWindow();
+            return 1;
+        }
+    }
+
+    data.rng = Rng(seed);
+    std::cout << "seed " << seed << std::endl;
+
+    if (obstaclesPath) {
+        if (loadObstacles(obstaclesPath, data.obstacles)) {
+            buildObstacleField(data.obstacles, data.config.obstacleRange, data.config.obstacleCellSize);
+        } else {
+            std::cerr << "could not load obstacles from " << obstaclesPath << std::endl;
+        }
+    }
+
+    if (replayPath) {
+        if (!openReplay(data.pipeline.replay, replayPath) || data.pipeline.replay.frameCount() == 0) {
+            std::cerr << "could not replay " << replayPath << std::endl;
+            CloseWindow();
+            return 1;
+        }
+        // nothing is simulated, the recording brings its own world
+        data.config = data.pipeline.replay.header->config;
+        pipelined = false;
+    }
+
+    // the tiles are laid out once, so the world can't follow the window
+    if (tileColumns > 0 && tileRows > 0 && !replayPath && (data.config.worldSize.x <= 0 || data.config.worldSize.y <= 0)) {
+        data.config.worldSize = { float(screenWidth), float(screenHeight) };
+    }
+
+    if (data.config.worldSize.x > 0 && data.config.worldSize.y > 0) {
+        fitCameraToWorld(data.config, data.camera);
+    }
+
+    if (tileColumns > 0 && tileRows > 0 && !replayPath) {
+        // the workers only take fixed steps
+        if (data.config.simRate <= 0) data.config.simRate = 60;
+        if (!startTiles(data.pipeline.tiles, data.config, data.obstacles, tileColumns, tileRows, 1.0f / data.config.simRate, data.rng.next64())) {
+            std::cerr << "could not start " << tileColumns << "x" << tileRows << " tiles, simulating in process" << std::endl;
+        }
+    }
+
+    startPipeline(data, pipelined);
+    if (budget > 0 && !replayPath) {
+        startGovernor(data.pipeline.governor, data.config, budget);
+    }
+
+    if (recordPath && !replayPath && !openRecording(data.pipeline.recording, recordPath, encoding, data.config)) {
+        std::cerr << "could not record to " << recordPath << std::endl;
+    }
+
+    std::thread simThread;
+    if (pipelined) {
+        simThread = std::thread(ThreadProc, &data);
+    }
 
     // Main game loop
     while (!WindowShouldClose())        // Detect window close button or ESC key
@@ -57,21 +165,14 @@ int main ()
 
         FrameMark;
     }
-    /*
     running = false;
-    t0.join();
-    t1.join();
-    t2.join();
-    t3.join();
-    t4.join();
-    t5.join();
-    t6.join();
-    t7.join();
-    */
-    
+    if (simThread.joinable()) {
+        simThread.join();
+    }
 
     // De-Initialization
     //--------------------------------------------------------------------------------------
+    Shutdown(data);
     CloseWindow();        // Close window and OpenGL context
     //--------------------------------------------------------------------------------------
     return 0;
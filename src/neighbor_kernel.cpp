@@ -0,0 +1,356 @@
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "neighbor_kernel.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BOIDS_KERNEL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BOIDS_KERNEL_SSE2
+#endif
+
+struct PackedBoid {
+    const float *positionsX;
+    const float *positionsY;
+    const float *velocitiesX;
+    const float *velocitiesY;
+    uint32_t slot;
+    float x;
+    float y;
+    float avoidRadiusSq;
+    float visibleRadiusSq;
+};
+
+static void accumulateScalar(const PackedBoid &boid, uint32_t begin, uint32_t end, NeighborSums &sums)
+{
+    for (uint32_t j = begin; j < end; j++) {
+        if (j == boid.slot) continue;
+
+        float dx = boid.x - boid.positionsX[j];
+        float dy = boid.y - boid.positionsY[j];
+        float distanceSq = dx * dx + dy * dy;
+
+        if (distanceSq <= boid.avoidRadiusSq) {
+            sums.close.x += dx;
+            sums.close.y += dy;
+        }
+
+        if (distanceSq <= boid.visibleRadiusSq) {
+            sums.count++;
+            sums.velocity.x += boid.velocitiesX[j];
+            sums.velocity.y += boid.velocitiesY[j];
+            sums.position.x += boid.positionsX[j];
+            sums.position.y += boid.positionsY[j];
+        }
+    }
+}
+
+#if defined(BOIDS_KERNEL_AVX2)
+
+struct Lanes {
+    typedef __m256 Float;
+    typedef __m256i Int;
+    static const uint32_t width = 8;
+
+    static Float zero() { return _mm256_setzero_ps(); }
+    static Float set(float v) { return _mm256_set1_ps(v); }
+    static Float load(const float *p) { return _mm256_loadu_ps(p); }
+    static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+    static Float lessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Float select(Float mask, Float v) { return _mm256_and_ps(mask, v); }
+    static Float exclude(Float mask, Float v) { return _mm256_andnot_ps(mask, v); }
+    static Int indices(uint32_t first) { return _mm256_add_epi32(_mm256_set1_epi32(int(first)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)); }
+    static Int set(uint32_t v) { return _mm256_set1_epi32(int(v)); }
+    static Int advance(Int v) { return _mm256_add_epi32(v, _mm256_set1_epi32(width)); }
+    static Float equal(Int a, Int b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+
+    static float sum(Float v)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+};
+
+#elif defined(BOIDS_KERNEL_SSE2)
+
+struct Lanes {
+    typedef __m128 Float;
+    typedef __m128i Int;
+    static const uint32_t width = 4;
+
+    static Float zero() { return _mm_setzero_ps(); }
+    static Float set(float v) { return _mm_set1_ps(v); }
+    static Float load(const float *p) { return _mm_loadu_ps(p); }
+    static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+    static Float lessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+    static Float select(Float mask, Float v) { return _mm_and_ps(mask, v); }
+    static Float exclude(Float mask, Float v) { return _mm_andnot_ps(mask, v); }
+    static Int indices(uint32_t first) { return _mm_add_epi32(_mm_set1_epi32(int(first)), _mm_setr_epi32(0, 1, 2, 3)); }
+    static Int set(uint32_t v) { return _mm_set1_epi32(int(v)); }
+    static Int advance(Int v) { return _mm_add_epi32(v, _mm_set1_epi32(width)); }
+    static Float equal(Int a, Int b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+
+    static float sum(Float v)
+    {
+        __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+};
+
+#endif
+
+#if defined(BOIDS_KERNEL_AVX2) || defined(BOIDS_KERNEL_SSE2)
+
+// per-lane running sums, reduced once per boid rather than once per range
+struct LaneSums {
+    Lanes::Float closeX = Lanes::zero();
+    Lanes::Float closeY = Lanes::zero();
+    Lanes::Float velocityX = Lanes::zero();
+    Lanes::Float velocityY = Lanes::zero();
+    Lanes::Float positionX = Lanes::zero();
+    Lanes::Float positionY = Lanes::zero();
+    Lanes::Float count = Lanes::zero();
+};
+
+static uint32_t accumulateLanes(const PackedBoid &boid, uint32_t begin, uint32_t end, LaneSums &lanes)
+{
+    const Lanes::Float x = Lanes::set(boid.x);
+    const Lanes::Float y = Lanes::set(boid.y);
+    const Lanes::Float avoidRadiusSq = Lanes::set(boid.avoidRadiusSq);
+    const Lanes::Float visibleRadiusSq = Lanes::set(boid.visibleRadiusSq);
+    const Lanes::Float one = Lanes::set(1.0f);
+    const Lanes::Int self = Lanes::set(boid.slot);
+    Lanes::Int index = Lanes::indices(begin);
+
+    uint32_t j = begin;
+    for (; j + Lanes::width <= end; j += Lanes::width) {
+        Lanes::Float otherX = Lanes::load(boid.positionsX + j);
+        Lanes::Float otherY = Lanes::load(boid.positionsY + j);
+        Lanes::Float dx = Lanes::sub(x, otherX);
+        Lanes::Float dy = Lanes::sub(y, otherY);
+        Lanes::Float distanceSq = Lanes::add(Lanes::mul(dx, dx), Lanes::mul(dy, dy));
+
+        // our own slot has a zero offset so it only needs masking out of
+        // the visible sums
+        Lanes::Float isSelf = Lanes::equal(index, self);
+        Lanes::Float avoid = Lanes::lessEqual(distanceSq, avoidRadiusSq);
+        Lanes::Float visible = Lanes::exclude(isSelf, Lanes::lessEqual(distanceSq, visibleRadiusSq));
+
+        lanes.closeX = Lanes::add(lanes.closeX, Lanes::select(avoid, dx));
+        lanes.closeY = Lanes::add(lanes.closeY, Lanes::select(avoid, dy));
+        lanes.count = Lanes::add(lanes.count, Lanes::select(visible, one));
+        lanes.velocityX = Lanes::add(lanes.velocityX, Lanes::select(visible, Lanes::load(boid.velocitiesX + j)));
+        lanes.velocityY = Lanes::add(lanes.velocityY, Lanes::select(visible, Lanes::load(boid.velocitiesY + j)));
+        lanes.positionX = Lanes::add(lanes.positionX, Lanes::select(visible, otherX));
+        lanes.positionY = Lanes::add(lanes.positionY, Lanes::select(visible, otherY));
+
+        index = Lanes::advance(index);
+    }
+
+    return j;
+}
+
+#endif
+
+static PackedBoid packedBoid(const UniformGrid &grid, uint32_t slot, const Config &config)
+{
+    return {
+        grid.positionsX.data(),
+        grid.positionsY.data(),
+        grid.velocitiesX.data(),
+        grid.velocitiesY.data(),
+        slot,
+        grid.positionsX[slot],
+        grid.positionsY[slot],
+        config.avoidRadius * config.avoidRadius,
+        config.visibleRadius * config.visibleRadius,
+    };
+}
+
+NeighborSums sumNeighborsPacked(const UniformGrid &grid, uint32_t slot, const Config &config, bool simd)
+{
+    PackedBoid boid = packedBoid(grid, slot, config);
+
+    NeighborSums sums = {};
+    Position position = { { boid.x, boid.y } };
+
+    // capped, the boid's own row goes first, then the nearest rows, and the
+    // walk stops after the row that reached the cap; uncapped, rows are
+    // summed top to bottom as before, in the same float order
+    int cap = config.neighborCap;
+
+#if defined(BOIDS_KERNEL_AVX2) || defined(BOIDS_KERNEL_SSE2)
+    if (simd) {
+        LaneSums lanes;
+        auto accumulateRow = [&](uint32_t begin, uint32_t end) {
+            uint32_t tail = accumulateLanes(boid, begin, end, lanes);
+            accumulateScalar(boid, tail, end, sums);
+            sums.visited += int(end - begin);
+        };
+        if (cap > 0) {
+            grid.forEachRangeOutward(position, [&](uint32_t begin, uint32_t end) {
+                accumulateRow(begin, end);
+                return sums.count + int(Lanes::sum(lanes.count)) < cap;
+            });
+        } else {
+            grid.forEachRange(position, accumulateRow);
+        }
+        sums.visited--;
+
+        sums.close.x += Lanes::sum(lanes.closeX);
+        sums.close.y += Lanes::sum(lanes.closeY);
+        sums.velocity.x += Lanes::sum(lanes.velocityX);
+        sums.velocity.y += Lanes::sum(lanes.velocityY);
+        sums.position.x += Lanes::sum(lanes.positionX);
+        sums.position.y += Lanes::sum(lanes.positionY);
+        sums.count += int(Lanes::sum(lanes.count));
+        return sums;
+    }
+#endif
+
+    auto accumulateRow = [&](uint32_t begin, uint32_t end) {
+        accumulateScalar(boid, begin, end, sums);
+        sums.visited += int(end - begin);
+    };
+    if (cap > 0) {
+        grid.forEachRangeOutward(position, [&](uint32_t begin, uint32_t end) {
+            accumulateRow(begin, end);
+            return sums.count < cap;
+        });
+    } else {
+        grid.forEachRange(position, accumulateRow);
+    }
+    // the boid's own slot is always in range
+    sums.visited--;
+
+    return sums;
+}
+
+// squared distances from (x, y) to the nearest and farthest points of a cell
+static void cellDistances(float x, float y, float left, float top, float size, float &nearestSq, float &farthestSq)
+{
+    float right = left + size;
+    float bottom = top + size;
+
+    float nx = std::max({ left - x, 0.0f, x - right });
+    float ny = std::max({ top - y, 0.0f, y - bottom });
+    float fx = std::max(fabsf(x - left), fabsf(x - right));
+    float fy = std::max(fabsf(y - top), fabsf(y - bottom));
+
+    nearestSq = nx * nx + ny * ny;
+    farthestSq = fx * fx + fy * fy;
+}
+
+NeighborSums sumNeighborsAggregated(const UniformGrid &grid, uint32_t slot, const Config &config)
+{
+    PackedBoid boid = packedBoid(grid, slot, config);
+    NeighborSums sums = {};
+    if (grid.columns == 0) return sums;
+
+    float reachSq = std::max(boid.avoidRadiusSq, boid.visibleRadiusSq);
+
+    int radius = getSpatialRadius(&config);
+    int index = grid.cellIndex({ { boid.x, boid.y } });
+    int cx = index % grid.columns;
+    int cy = index / grid.columns;
+
+    int x0 = std::max(cx - radius, 0);
+    int x1 = std::min(cx + radius, grid.columns - 1);
+    int y0 = std::max(cy - radius, 0);
+    int y1 = std::min(cy + radius, grid.rows - 1);
+
+#if defined(BOIDS_KERNEL_AVX2) || defined(BOIDS_KERNEL_SSE2)
+    LaneSums lanes;
+#endif
+
+    // neighboring exact cells of a row are contiguous slots, so they are
+    // summed as one run
+    auto exact = [&](uint32_t begin, uint32_t end) {
+        if (begin == end) return;
+#if defined(BOIDS_KERNEL_AVX2) || defined(BOIDS_KERNEL_SSE2)
+        uint32_t tail = accumulateLanes(boid, begin, end, lanes);
+        accumulateScalar(boid, tail, end, sums);
+#else
+        accumulateScalar(boid, begin, end, sums);
+#endif
+        sums.visited += int(end - begin);
+    };
+
+    for (int y = y0; y <= y1; y++) {
+        float top = (grid.originY + y) * grid.cellSize;
+        bool borderRow = y == 0 || y == grid.rows - 1;
+
+        uint32_t runBegin = grid.cellStart[y * grid.columns + x0];
+        uint32_t runEnd = runBegin;
+
+        for (int x = x0; x <= x1; x++) {
+            int c = y * grid.columns + x;
+            uint32_t begin = grid.cellStart[c];
+            uint32_t end = grid.cellStart[c + 1];
+
+            bool border = borderRow || x == 0 || x == grid.columns - 1;
+            if (begin != end && !border) {
+                float nearestSq, farthestSq;
+                cellDistances(boid.x, boid.y, (grid.originX + x) * grid.cellSize, top, grid.cellSize, nearestSq, farthestSq);
+
+                bool outOfReach = nearestSq > reachSq;
+                bool aggregated = nearestSq > boid.avoidRadiusSq && farthestSq <= boid.visibleRadiusSq;
+                if (outOfReach || aggregated) {
+                    exact(runBegin, runEnd);
+                    runBegin = runEnd = end;
+
+                    if (aggregated) {
+                        sums.count += int(end - begin);
+                        sums.velocity.x += grid.cellVelocitiesX[c];
+                        sums.velocity.y += grid.cellVelocitiesY[c];
+                        sums.position.x += grid.cellPositionsX[c];
+                        sums.position.y += grid.cellPositionsY[c];
+                        sums.visited++;
+                    }
+                    continue;
+                }
+            }
+
+            runEnd = end;
+        }
+
+        exact(runBegin, runEnd);
+    }
+
+#if defined(BOIDS_KERNEL_AVX2) || defined(BOIDS_KERNEL_SSE2)
+    sums.close.x += Lanes::sum(lanes.closeX);
+    sums.close.y += Lanes::sum(lanes.closeY);
+    sums.velocity.x += Lanes::sum(lanes.velocityX);
+    sums.velocity.y += Lanes::sum(lanes.velocityY);
+    sums.position.x += Lanes::sum(lanes.positionX);
+    sums.position.y += Lanes::sum(lanes.positionY);
+    sums.count += int(Lanes::sum(lanes.count));
+#endif
+
+    // the boid's own cell is never aggregated or skipped
+    sums.visited--;
+
+    return sums;
+}
+
+const char *neighborKernelName()
+{
+#if defined(BOIDS_KERNEL_AVX2)
+    return "avx2";
+#elif defined(BOIDS_KERNEL_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
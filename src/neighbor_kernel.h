@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+#include "raylib.h"
+
+#include "config.h"
+#include "uniform_grid.h"
+
+// what updateBoid needs to know about the neighborhood of one boid
+struct NeighborSums {
+    Vector2 close;      // sum of offsets to boids within avoidRadius
+    Vector2 velocity;   // sum of velocities of boids within visibleRadius
+    Vector2 position;   // sum of positions of boids within visibleRadius
+    int count;          // boids within visibleRadius
+    int visited;        // candidates the spatial index offered, itself excluded
+};
+
+// sums over the grid's packed arrays for the boid stored in slot, using
+// squared distances; simd picks the vector kernel when one was compiled in
+NeighborSums sumNeighborsPacked(const UniformGrid &grid, uint32_t slot, const Config &config, bool simd);
+
+// Level of detail version of sumNeighborsPacked: cells wholly inside
+// visibleRadius and clear of avoidRadius contribute their per-cell sums
+// instead of each boid, the rest are summed exactly. Border cells hold
+// clamped boids from outside the bounds and are always exact. visited
+// counts exact candidates plus one per aggregated cell.
+NeighborSums sumNeighborsAggregated(const UniformGrid &grid, uint32_t slot, const Config &config);
+
+// "avx2", "sse2" or "scalar", whichever kernel this build uses for simd
+const char *neighborKernelName();
@@ -0,0 +1,61 @@
+#include <atomic>
+
+#include "tracy/Tracy.hpp"
+
+#include "neighbor_list.h"
+#include "entities.h"
+#include "spatial_hash.h"
+
+static const size_t staleGrain = 4096;
+
+size_t NeighborLists::memoryUsage() const
+{
+    size_t bytes = start.capacity() * sizeof(uint32_t)
+        + neighbors.capacity() * sizeof(entt::entity)
+        + owners.capacity() * sizeof(entt::entity)
+        + builtAt.capacity() * sizeof(Vector2);
+
+    for (auto &chunk : chunkNeighbors) {
+        bytes += chunk.capacity() * sizeof(entt::entity);
+    }
+
+    return bytes;
+}
+
+bool neighborListsStale(const entt::registry &reg, const Config &config, const NeighborLists &lists, ThreadPool &pool)
+{
+    ZoneScoped;
+
+    const auto *boids = reg.storage<Boid>();
+    const auto *positions = reg.storage<Position>();
+    if (!boids || !positions) return true;
+
+    if (lists.owners.size() != boids->size()) return true;
+    if (lists.builtReach != getNeighborReach(&config) || lists.builtSkin != config.neighborSkin) return true;
+
+    float limit = config.neighborSkin * 0.5f;
+    float limitSq = limit * limit;
+    const entt::entity *entities = boids->data();
+
+    std::atomic<bool> stale = false;
+    pool.parallelFor(boids->size(), staleGrain, [&](size_t begin, size_t end, int worker) {
+        if (stale.load(std::memory_order_relaxed)) return;
+
+        for (size_t i = begin; i < end; i++) {
+            if (entities[i] != lists.owners[i]) {
+                stale.store(true, std::memory_order_relaxed);
+                return;
+            }
+
+            Vector2 p = positions->get(entities[i]).p;
+            float dx = p.x - lists.builtAt[i].x;
+            float dy = p.y - lists.builtAt[i].y;
+            if (dx * dx + dy * dy > limitSq) {
+                stale.store(true, std::memory_order_relaxed);
+                return;
+            }
+        }
+    });
+
+    return stale.load();
+}
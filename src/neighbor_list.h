@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "raylib.h"
+
+#include "config.h"
+#include "thread_pool.h"
+
+// Verlet neighbor lists: every boid's candidates within its reach plus
+// config.neighborSkin, kept across frames. Until some boid has moved half
+// the skin no pair can have closed from outside the list to within reach,
+// so the logic pass only has to walk the lists.
+//
+// Boid i of the Boid storage at build time owns
+// neighbors[start[i], start[i + 1]).
+struct NeighborLists {
+    std::vector<uint32_t> start;
+    std::vector<entt::entity> neighbors;
+
+    // who owned each slot and where it was when the lists were built
+    std::vector<entt::entity> owners;
+    std::vector<Vector2> builtAt;
+    float builtReach = 0;
+    float builtSkin = 0;
+
+    // per chunk scratch for parallel builds, each reserved for the largest
+    // chunk seen plus headroom so they stop growing once warmed up
+    std::vector<std::vector<entt::entity>> chunkNeighbors;
+    size_t chunkCapacity = 0;
+
+    size_t memoryUsage() const;
+};
+
+// true when the lists no longer cover every pair within reach: boids were
+// added, removed or reordered, the radii changed, or a boid moved more than
+// half the skin since the build
+bool neighborListsStale(const entt::registry &reg, const Config &config, const NeighborLists &lists, ThreadPool &pool);
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "raymath.h"
+
+#include "tracy/Tracy.hpp"
+
+#include "obstacles.h"
+
+size_t ObstacleField::memoryUsage() const
+{
+    size_t bytes = nodes.capacity() * sizeof(ObstacleNode)
+        + circles.capacity() * sizeof(ObstacleCircle)
+        + polygons.capacity() * sizeof(ObstaclePolygon);
+
+    for (auto &polygon : polygons) {
+        bytes += polygon.points.capacity() * sizeof(Vector2);
+    }
+
+    return bytes;
+}
+
+bool loadObstacles(const char *path, ObstacleField &field)
+{
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::vector<ObstacleCircle> circles;
+    std::vector<ObstaclePolygon> polygons;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string kind;
+        if (!(in >> kind) || kind[0] == '#') continue;
+
+        if (kind == "circle") {
+            ObstacleCircle circle;
+            if (!(in >> circle.center.x >> circle.center.y >> circle.radius) || circle.radius <= 0) return false;
+            circles.push_back(circle);
+        } else if (kind == "polygon") {
+            ObstaclePolygon polygon;
+            Vector2 point;
+            while (in >> point.x >> point.y) {
+                polygon.points.push_back(point);
+            }
+            if (polygon.points.size() < 3 || !in.eof()) return false;
+            polygons.push_back(std::move(polygon));
+        } else {
+            return false;
+        }
+    }
+
+    field.circles = std::move(circles);
+    field.polygons = std::move(polygons);
+    return true;
+}
+
+// even-odd rule
+static bool insidePolygon(const std::vector<Vector2> &points, Vector2 p)
+{
+    bool inside = false;
+    for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+        Vector2 a = points[i];
+        Vector2 b = points[j];
+        if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+static ObstacleSample circleDistance(const ObstacleCircle &circle, Vector2 p)
+{
+    Vector2 offset = Vector2Subtract(p, circle.center);
+    float length = Vector2Length(offset);
+    Vector2 gradient = length > 0 ? Vector2Scale(offset, 1.0f / length) : Vector2{ 1, 0 };
+    return { length - circle.radius, gradient };
+}
+
+static ObstacleSample polygonDistance(const ObstaclePolygon &polygon, Vector2 p)
+{
+    const auto &points = polygon.points;
+
+    float nearestSq = FLT_MAX;
+    Vector2 nearest = p;
+    for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+        Vector2 a = points[j];
+        Vector2 edge = Vector2Subtract(points[i], a);
+        float lengthSq = Vector2DotProduct(edge, edge);
+        float t = lengthSq > 0 ? Clamp(Vector2DotProduct(Vector2Subtract(p, a), edge) / lengthSq, 0, 1) : 0;
+        Vector2 q = Vector2Add(a, Vector2Scale(edge, t));
+
+        float dSq = Vector2DistanceSqr(p, q);
+        if (dSq < nearestSq) {
+            nearestSq = dSq;
+            nearest = q;
+        }
+    }
+
+    float sign = insidePolygon(points, p) ? -1.0f : 1.0f;
+    float length = sqrtf(nearestSq);
+    Vector2 gradient = length > 0 ? Vector2Scale(Vector2Subtract(p, nearest), sign / length) : Vector2{ 1, 0 };
+    return { sign * length, gradient };
+}
+
+void buildObstacleField(ObstacleField &field, float range, float cellSize)
+{
+    ZoneScoped;
+
+    field.range = range;
+    field.cellSize = cellSize;
+    field.columns = 0;
+    field.rows = 0;
+    field.nodes.clear();
+
+    // each obstacle's bounding box, the grid covers their union
+    std::vector<Rectangle> boxes;
+    for (auto &circle : field.circles) {
+        boxes.push_back({ circle.center.x - circle.radius, circle.center.y - circle.radius, circle.radius * 2, circle.radius * 2 });
+    }
+    for (auto &polygon : field.polygons) {
+        Vector2 lo = { FLT_MAX, FLT_MAX };
+        Vector2 hi = { -FLT_MAX, -FLT_MAX };
+        for (Vector2 point : polygon.points) {
+            lo = { fminf(lo.x, point.x), fminf(lo.y, point.y) };
+            hi = { fmaxf(hi.x, point.x), fmaxf(hi.y, point.y) };
+        }
+        boxes.push_back({ lo.x, lo.y, hi.x - lo.x, hi.y - lo.y });
+    }
+    if (boxes.empty() || cellSize <= 0) return;
+
+    Vector2 lo = { FLT_MAX, FLT_MAX };
+    Vector2 hi = { -FLT_MAX, -FLT_MAX };
+    for (Rectangle &box : boxes) {
+        box = { box.x - range, box.y - range, box.width + range * 2, box.height + range * 2 };
+        lo = { fminf(lo.x, box.x), fminf(lo.y, box.y) };
+        hi = { fmaxf(hi.x, box.x + box.width), fmaxf(hi.y, box.y + box.height) };
+    }
+
+    field.origin = lo;
+    field.columns = int(ceilf((hi.x - lo.x) / cellSize)) + 2;
+    field.rows = int(ceilf((hi.y - lo.y) / cellSize)) + 2;
+
+    field.nodes.assign(size_t(field.columns) * field.rows, ObstacleNode{ range, 0, 0 });
+
+    // every obstacle only writes the nodes within range of its box and
+    // keeps whichever surface is nearest, the union of the obstacles
+    auto stamp = [&](Rectangle box, auto &&distanceTo) {
+        int x0 = std::max(0, int(floorf((box.x - field.origin.x) / cellSize)));
+        int y0 = std::max(0, int(floorf((box.y - field.origin.y) / cellSize)));
+        int x1 = std::min(field.columns - 1, int(ceilf((box.x + box.width - field.origin.x) / cellSize)));
+        int y1 = std::min(field.rows - 1, int(ceilf((box.y + box.height - field.origin.y) / cellSize)));
+
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                Vector2 p = { field.origin.x + x * cellSize, field.origin.y + y * cellSize };
+                ObstacleSample s = distanceTo(p);
+
+                ObstacleNode &node = field.nodes[size_t(y) * field.columns + x];
+                if (s.distance < node.distance) {
+                    node = { s.distance, s.gradient.x, s.gradient.y };
+                }
+            }
+        }
+    };
+
+    size_t b = 0;
+    for (auto &circle : field.circles) {
+        stamp(boxes[b++], [&](Vector2 p) { return circleDistance(circle, p); });
+    }
+    for (auto &polygon : field.polygons) {
+        stamp(boxes[b++], [&](Vector2 p) { return polygonDistance(polygon, p); });
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "raylib.h"
+
+struct ObstacleCircle {
+    Vector2 center;
+    float radius;
+};
+
+struct ObstaclePolygon {
+    std::vector<Vector2> points;
+};
+
+// signed distance to the nearest obstacle surface, negative inside one, and
+// its gradient pointing away from the obstacle
+struct ObstacleSample {
+    float distance;
+    Vector2 gradient;
+};
+
+// one grid node, together so a bilinear sample reads two cache lines
+struct ObstacleNode {
+    float distance;
+    float gradientX;
+    float gradientY;
+};
+
+// Static obstacles plus a signed distance grid over them, so steering away
+// costs one bilinear sample per boid however many obstacles there are. The
+// grid covers the obstacles' bounding box grown by range; nodes further than
+// range from every obstacle, and everything off the grid, read as range.
+struct ObstacleField {
+    std::vector<ObstacleCircle> circles;
+    std::vector<ObstaclePolygon> polygons;
+
+    float range = 0;
+    float cellSize = 0;
+    Vector2 origin = {};
+    int columns = 0;
+    int rows = 0;
+
+    // row major
+    std::vector<ObstacleNode> nodes;
+
+    bool empty() const { return columns == 0; }
+
+    // bilinear sample of the grid
+    ObstacleSample sample(Vector2 position) const
+    {
+        float fx = (position.x - origin.x) / cellSize;
+        float fy = (position.y - origin.y) / cellSize;
+        if (!(fx >= 0 && fy >= 0 && fx < columns - 1 && fy < rows - 1)) {
+            return { range, { 0, 0 } };
+        }
+
+        int x = int(fx);
+        int y = int(fy);
+        float tx = fx - x;
+        float ty = fy - y;
+
+        const ObstacleNode *top = &nodes[size_t(y) * columns + x];
+        const ObstacleNode *bottom = top + columns;
+        auto lerp2 = [&](float ObstacleNode::*field) {
+            float upper = top[0].*field + (top[1].*field - top[0].*field) * tx;
+            float lower = bottom[0].*field + (bottom[1].*field - bottom[0].*field) * tx;
+            return upper + (lower - upper) * ty;
+        };
+
+        return { lerp2(&ObstacleNode::distance), { lerp2(&ObstacleNode::gradientX), lerp2(&ObstacleNode::gradientY) } };
+    }
+
+    size_t memoryUsage() const;
+};
+
+// Read obstacles from a text file, one per line:
+//   circle x y radius
+//   polygon x1 y1 x2 y2 x3 y3 ...
+// blank lines and lines starting with # are skipped. Returns false and
+// leaves field untouched if the file can't be read or a line is malformed.
+bool loadObstacles(const char *path, ObstacleField &field);
+
+// (re)build the distance grid with nodes cellSize apart, exact within range
+// of each obstacle; the cost grows with the obstacles' area, not the world's
+void buildObstacleField(ObstacleField &field, float range, float cellSize);
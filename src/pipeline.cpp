@@ -0,0 +1,190 @@
+#include <algorithm>
+
+#include "tracy/Tracy.hpp"
+
+#include "pipeline.h"
+#include "sim.h"
+
+// longest stretch of wall time simulated at once, after a stall the
+// simulation drops time instead of teleporting boids or trying to catch up
+static const float maxPipelineStep = 0.1f;
+
+double pipelineClock()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void startPipeline(GameData &data, bool threaded)
+{
+    Pipeline &pipeline = data.pipeline;
+    pipeline.threaded = threaded;
+    pipeline.frontConfig = data.config;
+    pipeline.frontPaused = data.paused;
+    pipeline.pending = {};
+    pipeline.pending.bounds = data.config.bounds;
+    pipeline.pending.paused = data.paused;
+    pipeline.started = false;
+    pipeline.accumulator = 0;
+
+    // with the simulation on its own thread, drawing gets a couple of
+    // threads of its own rather than contending for the simulation's pool
+    pipeline.renderPool.resize(threaded ? 2 : 1);
+}
+
+void postInput(Pipeline &pipeline, const SimInput &input)
+{
+    std::lock_guard lock(pipeline.inputMutex);
+
+    SimInput &pending = pipeline.pending;
+    pending.bounds = input.bounds;
+    pending.paused = input.paused;
+    pending.telemetry = input.telemetry;
+    pending.view = input.view;
+    pending.renderSeconds = input.renderSeconds;
+
+    if (input.clearSelection) {
+        pending.clearSelection = true;
+        pending.select = false;
+    }
+
+    if (input.select) {
+        pending.select = true;
+        pending.selectAdditive = input.selectAdditive;
+        pending.selectAt = input.selectAt;
+    }
+}
+
+void captureView(GameData &data, float dt, double time, std::vector<entt::entity> &visible, Snapshot &snapshot)
+{
+    if (data.view.width <= 0 || data.view.height <= 0) {
+        captureSnapshot(data.reg, data.config, dt, time, data.pool, snapshot);
+        return;
+    }
+
+    // room for a step of movement and the boids' own size, so nothing pops
+    // in at the edges while interpolating
+    float margin = data.config.maxSpeed * dt + data.config.visibleRadius;
+
+    // room for every boid, so panning across denser parts of the world
+    // doesn't grow the buffers mid-frame; reserved pages are only touched
+    // once they are used
+    size_t boids = data.reg.storage<Boid>().size();
+    visible.reserve(boids);
+    snapshot.positions.reserve(boids);
+    snapshot.lastPositions.reserve(boids);
+    snapshot.velocities.reserve(boids);
+
+    Rectangle rect = { data.view.x - margin, data.view.y - margin, data.view.width + margin * 2, data.view.height + margin * 2 };
+    collectBoidsInRect(data, rect, visible);
+    captureSnapshot(data.reg, data.config, visible, dt, time, data.pool, snapshot);
+}
+
+// Feed the governor this frame's work and apply whatever it changed. Inline,
+// a frame is the simulation plus drawing; threaded, the slower of the two
+// holds the frame rate back.
+static void governFrame(GameData &data, const SimInput &input, float simSeconds, float elapsed)
+{
+    Pipeline &pipeline = data.pipeline;
+    if (pipeline.governor.budget <= 0) return;
+
+    const Rectangle &view = data.view;
+    const Rectangle &bounds = data.config.bounds;
+    bool offscreen = view.width > 0 && view.height > 0
+        && (view.x > bounds.x || view.y > bounds.y || view.x + view.width < bounds.x + bounds.width || view.y + view.height < bounds.y + bounds.height);
+    GovernorScope scope = { true, offscreen };
+
+    float work = pipeline.threaded ? std::max(input.renderSeconds, pipeline.stepSeconds) : simSeconds + input.renderSeconds;
+    if (updateGovernor(pipeline.governor, data.config, scope, work, elapsed)) {
+        applyGovernor(pipeline.governor, data.config);
+    }
+}
+
+float pipelineStep(GameData &data)
+{
+    ZoneScoped;
+
+    Pipeline &pipeline = data.pipeline;
+
+    SimInput input;
+    {
+        std::lock_guard lock(pipeline.inputMutex);
+        input = pipeline.pending;
+        pipeline.pending.clearSelection = false;
+        pipeline.pending.select = false;
+    }
+
+    data.config.bounds = input.bounds;
+    data.paused = input.paused;
+    data.view = input.view;
+
+    if (input.clearSelection) {
+        data.reg.clear<Selected>();
+    }
+
+    if (input.select) {
+        selectNearest(data, input.selectAt, input.selectAdditive);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    float elapsed = pipeline.started ? std::chrono::duration<float>(now - pipeline.lastStep).count() : 0.0f;
+    elapsed = std::min(elapsed, maxPipelineStep);
+    pipeline.lastStep = now;
+    pipeline.started = true;
+
+    bool tiled = pipeline.tiles.shared != nullptr;
+    float dt = elapsed;
+    int steps = 1;
+    if (data.config.simRate > 0 || tiled) {
+        dt = tiled ? pipeline.tiles.dt : 1.0f / data.config.simRate;
+        pipeline.accumulator += elapsed;
+        steps = int(pipeline.accumulator / dt);
+        pipeline.accumulator -= steps * dt;
+    }
+
+    for (int i = 0; i < steps; i++) {
+        if (tiled) {
+            if (!data.paused) stepTiles(pipeline.tiles);
+        } else {
+            step(data, dt, &pipeline.timings, input.telemetry ? &pipeline.counters : nullptr);
+        }
+
+        if (pipeline.recording.file && !data.paused) {
+            if (tiled) {
+                captureTiles(pipeline.tiles, data.config, 0, data.pool, pipeline.tiles.offsets, pipeline.recorded);
+            } else {
+                captureSnapshot(data.reg, data.config, dt, 0, data.pool, pipeline.recorded);
+            }
+            recordSnapshot(pipeline.recording, pipeline.recorded, data.pool);
+        }
+    }
+    if (!input.telemetry) {
+        pipeline.counters = {};
+    }
+
+    if (steps > 0) {
+        markCandidates(data);
+        if (input.telemetry) {
+            pipeline.counters.governorLevel = pipeline.governor.level;
+        }
+
+        // the state just simulated belongs to the wall time the accumulator
+        // hasn't reached yet, which is what the renderer interpolates from
+        double time = pipelineClock() - pipeline.accumulator;
+        Snapshot &snapshot = pipeline.snapshots.writeBuffer();
+        if (tiled) {
+            captureTiles(pipeline.tiles, data.config, time, data.pool, pipeline.tiles.offsets, snapshot);
+        } else {
+            captureView(data, dt, time, pipeline.visible, snapshot);
+        }
+        snapshot.timings = pipeline.timings;
+        snapshot.counters = pipeline.counters;
+        snapshot.governor = pipeline.governor;
+        pipeline.snapshots.publish();
+
+        pipeline.stepSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - now).count() / steps;
+    }
+
+    governFrame(data, input, std::chrono::duration<float>(std::chrono::steady_clock::now() - now).count(), elapsed);
+
+    return data.config.simRate > 0 ? float(dt - pipeline.accumulator) : 0.0f;
+}
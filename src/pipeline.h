@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+
+#include "raylib.h"
+
+#include "config.h"
+#include "governor.h"
+#include "recording.h"
+#include "snapshot.h"
+#include "thread_pool.h"
+#include "tiles.h"
+#include "triple_buffer.h"
+
+struct GameData;
+
+// what the render thread asks of the simulation for its next step
+struct SimInput {
+    Rectangle bounds;
+    bool paused;
+    // gather SimCounters each step
+    bool telemetry;
+    // world space area on screen
+    Rectangle view;
+    // how long the last frame took to draw
+    float renderSeconds;
+
+    bool clearSelection;
+    bool select;
+    bool selectAdditive;
+    Vector2 selectAt;
+};
+
+// Connects the simulation to the renderer. The simulation side runs
+// pipelineStep, either inline each frame or on its own thread, and
+// publishes a Snapshot per step; the render side only touches the fields
+// marked as its own and reads snapshots.
+struct Pipeline {
+    bool threaded = false;
+
+    TripleBuffer<Snapshot> snapshots;
+
+    std::mutex inputMutex;
+    SimInput pending = {};
+
+    // render side copies of the state the player edits
+    Config frontConfig = {};
+    bool frontPaused = false;
+    bool frontTelemetry = false;
+    ThreadPool renderPool;
+    float renderSeconds = 0;
+
+    // simulation side
+    std::chrono::steady_clock::time_point lastStep;
+    bool started = false;
+    // wall time not yet simulated, under one step at a fixed simRate
+    double accumulator = 0;
+    SimTimings timings;
+    SimCounters counters;
+    std::vector<entt::entity> visible;
+    // holds frames to a budget, see FrameGovernor; startGovernor turns it on
+    FrameGovernor governor;
+    // once started the boids live in worker processes instead of data.reg,
+    // see TileCluster, and steps take the cluster's dt
+    TileCluster tiles;
+    // what the last step took, captured and published
+    float stepSeconds = 0;
+    // every step appended here while the file is open, captured whole
+    // whatever the view
+    RecordingWriter recording;
+    Snapshot recorded;
+
+    // render side, replaying instead of simulating while frames are loaded
+    Replay replay;
+    Snapshot replayed;
+    int replayedFrame = -1;
+    // simulated seconds into the replay
+    double replayTime = 0;
+};
+
+// seconds on the steady clock, the time base of Snapshot::time
+double pipelineClock();
+
+void startPipeline(GameData &data, bool threaded);
+// merge the render side's input into what the next step will apply
+void postInput(Pipeline &pipeline, const SimInput &input);
+// apply pending input, catch the simulation up with the wall time since the
+// last call and publish a snapshot if it stepped; returns the seconds until
+// the next step is due
+float pipelineStep(GameData &data);
+
+// capture the boids around data.view, or every boid while no view is set;
+// visible is scratch for the culled entity list
+void captureView(GameData &data, float dt, double time, std::vector<entt::entity> &visible, Snapshot &snapshot);
@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "raymath.h"
+
+#include "tracy/Tracy.hpp"
+
+#include "recording.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BOIDS_RECORDING_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char recordingMagic[8] = { 'B', 'O', 'I', 'D', 'R', 'E', 'C', 0 };
+static const char indexMagic[8] = { 'B', 'O', 'I', 'D', 'I', 'D', 'X', 0 };
+static const uint32_t frameMagic = 0x4d415246; // "FRAM"
+// the header holds a Config, so any change to it is a new version
+static const uint32_t recordingVersion = 2;
+
+static const size_t recordGrain = 16384;
+
+static uint64_t alignUp(uint64_t bytes)
+{
+    return (bytes + 7) & ~uint64_t(7);
+}
+
+static bool writeBytes(RecordingWriter &writer, const void *data, size_t bytes)
+{
+    writer.offset += bytes;
+    return fwrite(data, 1, bytes, writer.file) == bytes;
+}
+
+static bool writePadding(RecordingWriter &writer)
+{
+    static const char zeros[8] = {};
+    return writeBytes(writer, zeros, size_t(alignUp(writer.offset) - writer.offset));
+}
+
+bool openRecording(RecordingWriter &writer, const char *path, RecordingEncoding encoding, const Config &config)
+{
+    writer.file = fopen(path, "wb");
+    if (!writer.file) return false;
+
+    // frames are large and written whole, no use flushing in small pieces
+    setvbuf(writer.file, nullptr, _IOFBF, 1 << 20);
+
+    writer.encoding = encoding;
+    writer.offsets.clear();
+    writer.offset = 0;
+    writer.time = 0;
+
+    size_t count = size_t(std::max(config.count, 0));
+    if (encoding == RECORDING_QUANTIZED) {
+        writer.scratch.reserve(size_t(alignUp(count * sizeof(uint16_t) * 4)));
+        writer.ranges.reserve((count + recordGrain - 1) / recordGrain);
+    }
+
+    RecordingHeader header = {};
+    memcpy(header.magic, recordingMagic, sizeof(header.magic));
+    header.version = recordingVersion;
+    header.encoding = encoding;
+    header.config = config;
+
+    if (!writeBytes(writer, &header, sizeof(header)) || !writePadding(writer)) {
+        fclose(writer.file);
+        writer.file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool recordSnapshot(RecordingWriter &writer, const Snapshot &snapshot, ThreadPool &pool)
+{
+    ZoneScoped;
+
+    if (!writer.file) return false;
+
+    size_t count = size_t(snapshot.count);
+    writer.time += snapshot.dt;
+
+    RecordingFrame frame = {};
+    frame.magic = frameMagic;
+    frame.count = uint32_t(count);
+    frame.time = writer.time;
+    frame.dt = snapshot.dt;
+    frame.bounds = snapshot.config.bounds;
+
+    const Vector2 *positions = snapshot.positions.data();
+    const Vector2 *velocities = snapshot.velocities.data();
+
+    if (writer.encoding == RECORDING_FLOAT) {
+        frame.bytes = alignUp(count * sizeof(Vector2) * 2);
+        writer.offsets.push_back(writer.offset);
+        return writeBytes(writer, &frame, sizeof(frame))
+            && writeBytes(writer, positions, count * sizeof(Vector2))
+            && writeBytes(writer, velocities, count * sizeof(Vector2))
+            && writePadding(writer);
+    }
+
+    // the frame's extent and fastest velocity component, per chunk first
+    size_t chunks = (count + recordGrain - 1) / recordGrain;
+    std::vector<RecordingRange> &ranges = writer.ranges;
+    ranges.assign(chunks, RecordingRange{ { FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX }, 0 });
+    pool.parallelFor(count, recordGrain, [&](size_t begin, size_t end, int worker) {
+        RecordingRange &range = ranges[begin / recordGrain];
+        for (size_t i = begin; i < end; i++) {
+            range.lo = { std::min(range.lo.x, positions[i].x), std::min(range.lo.y, positions[i].y) };
+            range.hi = { std::max(range.hi.x, positions[i].x), std::max(range.hi.y, positions[i].y) };
+            range.speed = std::max({ range.speed, fabsf(velocities[i].x), fabsf(velocities[i].y) });
+        }
+    });
+
+    RecordingRange all = { { 0, 0 }, { 0, 0 }, 0 };
+    if (chunks > 0) {
+        all = ranges[0];
+        for (const RecordingRange &range : ranges) {
+            all.lo = { fminf(all.lo.x, range.lo.x), fminf(all.lo.y, range.lo.y) };
+            all.hi = { fmaxf(all.hi.x, range.hi.x), fmaxf(all.hi.y, range.hi.y) };
+            all.speed = fmaxf(all.speed, range.speed);
+        }
+    }
+
+    frame.extent = { all.lo.x, all.lo.y, all.hi.x - all.lo.x, all.hi.y - all.lo.y };
+    frame.velocityScale = all.speed > 0 ? all.speed / 32767.0f : 1.0f;
+    frame.bytes = alignUp(count * sizeof(uint16_t) * 4);
+
+    writer.scratch.resize(size_t(frame.bytes));
+    uint16_t *quantizedPositions = reinterpret_cast<uint16_t *>(writer.scratch.data());
+    int16_t *quantizedVelocities = reinterpret_cast<int16_t *>(quantizedPositions + count * 2);
+
+    float scaleX = frame.extent.width > 0 ? 65535.0f / frame.extent.width : 0;
+    float scaleY = frame.extent.height > 0 ? 65535.0f / frame.extent.height : 0;
+    float velocityScale = 1.0f / frame.velocityScale;
+    // rounded by truncating from half a step up, everything is offset to be
+    // positive first
+    pool.parallelFor(count, recordGrain, [&](size_t begin, size_t end, int worker) {
+        for (size_t i = begin; i < end; i++) {
+            quantizedPositions[i * 2] = uint16_t(int((positions[i].x - frame.extent.x) * scaleX + 0.5f));
+            quantizedPositions[i * 2 + 1] = uint16_t(int((positions[i].y - frame.extent.y) * scaleY + 0.5f));
+            quantizedVelocities[i * 2] = int16_t(int(velocities[i].x * velocityScale + 32768.5f) - 32768);
+            quantizedVelocities[i * 2 + 1] = int16_t(int(velocities[i].y * velocityScale + 32768.5f) - 32768);
+        }
+    });
+
+    writer.offsets.push_back(writer.offset);
+    return writeBytes(writer, &frame, sizeof(frame)) && writeBytes(writer, writer.scratch.data(), writer.scratch.size());
+}
+
+bool closeRecording(RecordingWriter &writer)
+{
+    if (!writer.file) return false;
+
+    RecordingFooter footer = {};
+    footer.indexOffset = writer.offset;
+    footer.frames = writer.offsets.size();
+    memcpy(footer.magic, indexMagic, sizeof(footer.magic));
+
+    bool ok = writeBytes(writer, writer.offsets.data(), writer.offsets.size() * sizeof(uint64_t))
+        && writeBytes(writer, &footer, sizeof(footer));
+    ok = fclose(writer.file) == 0 && ok;
+    writer.file = nullptr;
+    return ok;
+}
+
+int Replay::frameAt(double time) const
+{
+    if (frames.empty()) return -1;
+
+    auto it = std::lower_bound(frames.begin(), frames.end(), time, [](const RecordingFrame *frame, double time) {
+        return frame->time < time;
+    });
+    return int(std::min(size_t(it - frames.begin()), frames.size() - 1));
+}
+
+// the chunk at offset, if it is whole
+static const RecordingFrame *frameAtOffset(const Replay &replay, uint64_t offset)
+{
+    if (offset % 8 != 0 || offset + sizeof(RecordingFrame) > replay.size) return nullptr;
+
+    auto *frame = reinterpret_cast<const RecordingFrame *>(replay.data + offset);
+    uint64_t quantum = replay.header->encoding == RECORDING_FLOAT ? sizeof(Vector2) * 2 : sizeof(uint16_t) * 4;
+    if (frame->magic != frameMagic || frame->bytes < frame->count * quantum || frame->bytes > replay.size - offset - sizeof(RecordingFrame)) return nullptr;
+
+    return frame;
+}
+
+static bool indexFrames(Replay &replay)
+{
+    replay.frames.clear();
+
+    // through the index when the writer got to write it
+    if (replay.size >= sizeof(RecordingFooter)) {
+        auto *footer = reinterpret_cast<const RecordingFooter *>(replay.data + replay.size - sizeof(RecordingFooter));
+        bool indexed = memcmp(footer->magic, indexMagic, sizeof(footer->magic)) == 0
+            && footer->indexOffset % 8 == 0
+            && footer->frames <= (replay.size - sizeof(RecordingFooter)) / sizeof(uint64_t)
+            && footer->indexOffset + footer->frames * sizeof(uint64_t) + sizeof(RecordingFooter) == replay.size;
+
+        if (indexed) {
+            auto *offsets = reinterpret_cast<const uint64_t *>(replay.data + footer->indexOffset);
+            for (uint64_t f = 0; f < footer->frames; f++) {
+                const RecordingFrame *frame = frameAtOffset(replay, offsets[f]);
+                if (!frame) break;
+                replay.frames.push_back(frame);
+            }
+            if (replay.frames.size() == footer->frames) return true;
+            replay.frames.clear();
+        }
+    }
+
+    // otherwise chunk by chunk, up to the first one cut short
+    uint64_t offset = alignUp(sizeof(RecordingHeader));
+    while (const RecordingFrame *frame = frameAtOffset(replay, offset)) {
+        replay.frames.push_back(frame);
+        offset += sizeof(RecordingFrame) + frame->bytes;
+    }
+    return true;
+}
+
+bool openReplay(Replay &replay, const char *path)
+{
+    closeReplay(replay);
+
+#ifdef BOIDS_RECORDING_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    replay.data = static_cast<const char *>(mapping);
+    replay.size = size_t(info.st_size);
+#else
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    replay.buffer.resize(size > 0 ? size_t(size) : 0);
+    bool read = size > 0 && fread(replay.buffer.data(), 1, replay.buffer.size(), file) == replay.buffer.size();
+    fclose(file);
+    if (!read) {
+        replay.buffer.clear();
+        return false;
+    }
+
+    replay.data = replay.buffer.data();
+    replay.size = replay.buffer.size();
+#endif
+
+    replay.header = reinterpret_cast<const RecordingHeader *>(replay.data);
+    bool valid = replay.size >= sizeof(RecordingHeader)
+        && memcmp(replay.header->magic, recordingMagic, sizeof(recordingMagic)) == 0
+        && replay.header->version == recordingVersion
+        && (replay.header->encoding == RECORDING_FLOAT || replay.header->encoding == RECORDING_QUANTIZED);
+
+    if (!valid || !indexFrames(replay)) {
+        closeReplay(replay);
+        return false;
+    }
+    return true;
+}
+
+void closeReplay(Replay &replay)
+{
+#ifdef BOIDS_RECORDING_MMAP
+    if (replay.data && replay.buffer.empty()) {
+        munmap(const_cast<char *>(replay.data), replay.size);
+    }
+#endif
+    replay.data = nullptr;
+    replay.size = 0;
+    replay.buffer.clear();
+    replay.header = nullptr;
+    replay.frames.clear();
+}
+
+void replayFrame(const Replay &replay, int frameIndex, ThreadPool &pool, Snapshot &snapshot)
+{
+    ZoneScoped;
+
+    const RecordingFrame &frame = *replay.frames[frameIndex];
+    size_t count = frame.count;
+
+    snapshot.config = replay.header->config;
+    snapshot.config.bounds = frame.bounds;
+    snapshot.count = int(count);
+    snapshot.total = int(count);
+    snapshot.dt = frame.dt;
+    snapshot.time = frame.time;
+    snapshot.highlights.clear();
+    snapshot.selected.clear();
+    snapshot.timings = {};
+    snapshot.counters = {};
+    snapshot.positions.resize(count);
+    snapshot.lastPositions.resize(count);
+    snapshot.velocities.resize(count);
+
+    const char *payload = reinterpret_cast<const char *>(&frame + 1);
+    float dt = frame.dt;
+
+    if (replay.header->encoding == RECORDING_FLOAT) {
+        auto *positions = reinterpret_cast<const Vector2 *>(payload);
+        auto *velocities = positions + count;
+        pool.parallelFor(count, recordGrain, [&](size_t begin, size_t end, int worker) {
+            for (size_t i = begin; i < end; i++) {
+                snapshot.positions[i] = positions[i];
+                snapshot.velocities[i] = velocities[i];
+                snapshot.lastPositions[i] = Vector2Subtract(positions[i], Vector2Scale(velocities[i], dt));
+            }
+        });
+        return;
+    }
+
+    auto *positions = reinterpret_cast<const uint16_t *>(payload);
+    auto *velocities = reinterpret_cast<const int16_t *>(positions + count * 2);
+    float stepX = frame.extent.width / 65535.0f;
+    float stepY = frame.extent.height / 65535.0f;
+    pool.parallelFor(count, recordGrain, [&](size_t begin, size_t end, int worker) {
+        for (size_t i = begin; i < end; i++) {
+            Vector2 position = { frame.extent.x + positions[i * 2] * stepX, frame.extent.y + positions[i * 2 + 1] * stepY };
+            Vector2 velocity = { velocities[i * 2] * frame.velocityScale, velocities[i * 2 + 1] * frame.velocityScale };
+            snapshot.positions[i] = position;
+            snapshot.velocities[i] = velocity;
+            snapshot.lastPositions[i] = Vector2Subtract(position, Vector2Scale(velocity, dt));
+        }
+    });
+}
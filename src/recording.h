@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "raylib.h"
+
+#include "config.h"
+#include "snapshot.h"
+#include "thread_pool.h"
+
+// Recordings are a RecordingHeader, one chunk per frame and an index of
+// where each chunk starts:
+//
+//   RecordingHeader
+//   RecordingFrame, positions, velocities     (repeated)
+//   uint64_t offsets[frames]
+//   RecordingFooter
+//
+// Chunks are self describing, so a recording whose writer never closed it
+// (crashed, killed) still replays by walking the chunks instead of the index.
+// Last positions are not stored, they are position - velocity * dt.
+
+enum RecordingEncoding : uint32_t {
+    RECORDING_FLOAT,     // Vector2 positions, then Vector2 velocities
+    RECORDING_QUANTIZED, // uint16 x, y across the frame's extent, then
+                         // int16 x, y velocities scaled by velocityScale
+};
+
+struct RecordingHeader {
+    char magic[8];
+    uint32_t version;
+    RecordingEncoding encoding;
+    // the config of the first frame, for radii and world size
+    Config config;
+};
+
+struct RecordingFrame {
+    uint32_t magic;
+    uint32_t count;
+    // bytes of boid data after this header, padded to 8
+    uint64_t bytes;
+    // simulated seconds, time is the sum of every dt so far
+    double time;
+    float dt;
+    // quantized frames only, what uint16 0 and 65535 stand for and the
+    // velocity a step of int16 is
+    float velocityScale;
+    Rectangle extent;
+    Rectangle bounds;
+};
+
+struct RecordingFooter {
+    uint64_t indexOffset;
+    uint64_t frames;
+    char magic[8];
+};
+
+// extent and fastest velocity component of a chunk of a quantized frame
+struct RecordingRange {
+    Vector2 lo;
+    Vector2 hi;
+    float speed;
+};
+
+struct RecordingWriter {
+    FILE *file = nullptr;
+    RecordingEncoding encoding = RECORDING_FLOAT;
+    std::vector<uint64_t> offsets;
+    uint64_t offset = 0;
+    double time = 0;
+    // sized for config.count by openRecording, so frames don't allocate
+    std::vector<char> scratch;
+    std::vector<RecordingRange> ranges;
+};
+
+bool openRecording(RecordingWriter &writer, const char *path, RecordingEncoding encoding, const Config &config);
+// append every boid in snapshot as the next frame
+bool recordSnapshot(RecordingWriter &writer, const Snapshot &snapshot, ThreadPool &pool);
+// write the index; the recording replays without it, only slower to open
+bool closeRecording(RecordingWriter &writer);
+
+// A recording mapped into memory, frames are decoded straight out of the
+// mapping without reading the file.
+struct Replay {
+    const char *data = nullptr;
+    size_t size = 0;
+    // whole file read into memory where there is no mmap
+    std::vector<char> buffer;
+
+    const RecordingHeader *header = nullptr;
+    std::vector<const RecordingFrame *> frames;
+
+    int frameCount() const { return int(frames.size()); }
+    // simulated seconds covered
+    double duration() const { return frames.empty() ? 0 : frames.back()->time; }
+    // the frame being played time seconds in, the one whose step spans it
+    int frameAt(double time) const;
+};
+
+bool openReplay(Replay &replay, const char *path);
+void closeReplay(Replay &replay);
+// decode frame into snapshot, as captureSnapshot would have filled it
+void replayFrame(const Replay &replay, int frame, ThreadPool &pool, Snapshot &snapshot);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+// Allocator for node based containers that keeps freed single elements on a
+// per-thread free list instead of handing them back to the heap. A container
+// that keeps inserting and erasing about as many elements as it holds, like
+// the spatial hash cells, stops allocating once it has warmed up. Arrays,
+// e.g. bucket tables, go straight to the heap.
+template <typename T>
+struct RecyclingAllocator {
+    using value_type = T;
+
+    RecyclingAllocator() = default;
+    template <typename U>
+    RecyclingAllocator(const RecyclingAllocator<U> &) {}
+
+    T *allocate(std::size_t n)
+    {
+        if (n == 1 && recyclable) {
+            FreeList &list = freeList();
+            if (list.head) {
+                Block *block = list.head;
+                list.head = block->next;
+                return reinterpret_cast<T *>(block);
+            }
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n)
+    {
+        if (n == 1 && recyclable) {
+            FreeList &list = freeList();
+            Block *block = reinterpret_cast<Block *>(p);
+            block->next = list.head;
+            list.head = block;
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const RecyclingAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const RecyclingAllocator<U> &) const { return false; }
+
+private:
+    struct Block {
+        Block *next;
+    };
+
+    static constexpr bool recyclable = sizeof(T) >= sizeof(Block) && alignof(T) >= alignof(Block) && alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    // one list per thread and element type, so no locking; blocks freed on
+    // another thread than they came from just move to that thread's list
+    struct FreeList {
+        Block *head = nullptr;
+
+        ~FreeList()
+        {
+            while (head) {
+                Block *next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+        }
+    };
+
+    static FreeList &freeList()
+    {
+        thread_local FreeList list;
+        return list;
+    }
+};
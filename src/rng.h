@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// PCG32 (pcg-random.org): tiny, fast, and every stream is an independent
+// sequence for the same seed, so chunks of parallel work can each get one
+struct Rng {
+    uint64_t state = 0;
+    uint64_t increment = 0;
+
+    Rng(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t stream = 0)
+    {
+        increment = (stream << 1) | 1;
+        next();
+        state += seed;
+        next();
+    }
+
+    uint32_t next()
+    {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + increment;
+        uint32_t xorshifted = uint32_t(((old >> 18) ^ old) >> 27);
+        uint32_t rot = uint32_t(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+
+    uint64_t next64()
+    {
+        return (uint64_t(next()) << 32) | next();
+    }
+
+    // uniform in [0, 1)
+    float nextFloat()
+    {
+        return (next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float range(float lo, float hi)
+    {
+        return lo + (hi - lo) * nextFloat();
+    }
+};
@@ -0,0 +1,956 @@
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <mutex>
+#include <utility>
+
+#include "raylib.h"
+#include "raymath.h"
+
+#include "tracy/Tracy.hpp"
+
+#include "boid_rules.h"
+#include "neighbor_kernel.h"
+#include "sim.h"
+
+// boids per chunk handed to a worker, the neighbor search is far heavier
+// per boid than the plain integration passes
+static const size_t logicGrain = 256;
+static const size_t passGrain = 4096;
+// every nth boid is also run through the exact kernel to measure the error
+// of KERNEL_AGGREGATE
+static const uint32_t aggregateErrorStride = 61;
+
+// call func(entity) for every boid, split across the pool
+template <typename Func>
+static void parallelEachBoid(entt::registry &reg, ThreadPool &pool, size_t grain, Func &&func)
+{
+    const auto &boids = reg.storage<Boid>();
+    const entt::entity *entities = boids.data();
+
+    pool.parallelFor(boids.size(), grain, [&](size_t begin, size_t end, int worker) {
+        for (size_t i = begin; i < end; i++) {
+            func(entities[i]);
+        }
+    });
+}
+
+// boids per chunk when filling in new boids, each chunk gets its own
+// random stream so the result does not depend on the thread count
+static const size_t spawnGrain = 4096;
+
+void createBoidsBulk(entt::registry &reg, size_t count, std::vector<entt::entity> &created)
+{
+    ZoneScoped;
+
+    created.resize(count);
+    reg.create(created.begin(), created.end());
+
+    reg.insert<Boid>(created.begin(), created.end());
+    reg.insert<Position>(created.begin(), created.end());
+    reg.insert<LastPosition>(created.begin(), created.end());
+    reg.insert<Velocity>(created.begin(), created.end());
+    reg.insert<NextVelocity>(created.begin(), created.end());
+    reg.insert<BoidColor>(created.begin(), created.end(), BoidColor{ Color{0, 255, 255, 255} });
+}
+
+void spawnBoidsBulk(entt::registry &reg, const Config &config, size_t count, uint64_t seed, ThreadPool &pool, std::vector<entt::entity> &created)
+{
+    ZoneScoped;
+
+    createBoidsBulk(reg, count, created);
+
+    auto &positions = reg.storage<Position>();
+    auto &lastPositions = reg.storage<LastPosition>();
+    auto &velocities = reg.storage<Velocity>();
+    pool.parallelFor(count, spawnGrain, [&](size_t begin, size_t end, int worker) {
+        Rng rng(seed, begin / spawnGrain);
+
+        for (size_t i = begin; i < end; i++) {
+            entt::entity entity = created[i];
+            auto p = Vector2{ rng.range(config.bounds.x, config.bounds.width + config.bounds.x), rng.range(config.bounds.y, config.bounds.height + config.bounds.y) };
+            positions.get(entity).p = p;
+            lastPositions.get(entity).p = p;
+            velocities.get(entity).v = Vector2{ rng.range(-config.maxSpeed, config.maxSpeed), rng.range(-config.maxSpeed, config.maxSpeed) };
+        }
+    });
+}
+
+void despawnBoidsBulk(entt::registry &reg, size_t count, std::vector<entt::entity> &destroyed)
+{
+    ZoneScoped;
+
+    // the most recently added boids go first
+    const auto &boids = reg.storage<Boid>();
+    count = std::min(count, boids.size());
+    destroyed.assign(boids.data() + boids.size() - count, boids.data() + boids.size());
+
+    reg.destroy(destroyed.begin(), destroyed.end());
+}
+
+void spawnBoids(GameData &data)
+{
+    ZoneScoped;
+
+    auto &reg = data.reg;
+    const auto &config = data.config;
+
+    size_t current = reg.storage<Boid>().size();
+    size_t wanted = size_t(std::max(config.count, 0));
+
+    if (current < wanted) {
+        spawnBoidsBulk(reg, config, wanted - current, data.rng.next64(), data.pool, data.spawnScratch);
+
+        if (config.spatialMode == SPATIAL_HASH) {
+            for (auto entity : data.spawnScratch) {
+                data.spatialHash.insert(entity, reg.get<Position>(entity));
+            }
+        }
+    }
+    else if (current > wanted) {
+        despawnBoidsBulk(reg, current - wanted, data.spawnScratch);
+
+        if (config.spatialMode == SPATIAL_HASH) {
+            for (auto entity : data.spawnScratch) {
+                data.spatialHash.remove(entity);
+            }
+        }
+    }
+}
+
+// push velocity away from obstacles within the field's range, by
+// obstacleFactor at the surface and more inside
+static Vector2 obstacleSteering(const ObstacleField &obstacles, const Config &config, Vector2 position, Vector2 velocity)
+{
+    ObstacleSample sample = obstacles.sample(position);
+    if (sample.distance >= obstacles.range) return velocity;
+
+    float push = config.obstacleFactor * (1 - sample.distance / obstacles.range);
+    return Vector2Add(velocity, Vector2Scale(sample.gradient, push));
+}
+
+void updateTurnFactor(entt::registry &reg, Config &config, ThreadPool &pool)
+{
+    ZoneScoped;
+
+    const auto boids = reg.view<Position, Velocity>();
+    parallelEachBoid(reg, pool, passGrain, [&](entt::entity entity) {
+        auto [position, velocity] = boids.get(entity);
+
+        if (position.p.x < config.bounds.x) {
+            velocity.v.x += config.turnFactor;
+        } else if (position.p.x > config.bounds.width + config.bounds.x) {
+            velocity.v.x -= config.turnFactor;
+        }
+
+        if (position.p.y < config.bounds.y) {
+            velocity.v.y += config.turnFactor;
+        } else if (position.p.y > config.bounds.height + config.bounds.y) {
+            velocity.v.y -= config.turnFactor;
+        }
+    });
+}
+
+void avoidObstacles(entt::registry &reg, const Config &config, const ObstacleField &obstacles, ThreadPool &pool)
+{
+    ZoneScoped;
+
+    const auto boids = reg.view<const Position, Velocity>();
+    parallelEachBoid(reg, pool, passGrain, [&](entt::entity entity) {
+        auto [position, velocity] = boids.get(entity);
+        velocity.v = obstacleSteering(obstacles, config, position.p, velocity.v);
+    });
+}
+
+void moveEntities(entt::registry &reg, float deltaTime, ThreadPool &pool)
+{
+    ZoneScoped;
+
+    const auto boids = reg.view<Position, LastPosition, Velocity>();
+    parallelEachBoid(reg, pool, passGrain, [&](entt::entity entity) {
+        auto [position, lastPosition, velocity] = boids.get(entity);
+        // kept so the renderer can interpolate across this step
+        lastPosition.p = position.p;
+        position.p = Vector2Add(position.p, Vector2Multiply(velocity.v, Vector2{deltaTime, deltaTime}));
+    });
+}
+
+// calls func(Rules{}, std::bool_constant<Counted>{}) with the rules config
+// enables, Counted when there are counters to fill in, so the per-boid
+// loops carry neither disabled rules nor telemetry they don't need
+template <typename Func>
+static void withLogicVariant(const Config &config, const SimCounters *counters, Func &&func)
+{
+    withBoidRules(config, [&](auto rules) {
+        if (counters) {
+            func(rules, std::true_type{});
+        } else {
+            func(rules, std::false_type{});
+        }
+    });
+}
+
+// neighbor counts summed per chunk and added once, so counting costs the
+// workers next to nothing
+struct NeighborTally {
+    std::atomic<uint64_t> visited = 0;
+    std::atomic<uint64_t> accepted = 0;
+    std::atomic<int> deferred = 0;
+
+    void add(uint64_t chunkVisited, uint64_t chunkAccepted, int chunkDeferred)
+    {
+        visited.fetch_add(chunkVisited, std::memory_order_relaxed);
+        accepted.fetch_add(chunkAccepted, std::memory_order_relaxed);
+        deferred.fetch_add(chunkDeferred, std::memory_order_relaxed);
+    }
+
+    void report(SimCounters *counters) const
+    {
+        if (!counters) return;
+        counters->visited = visited.load(std::memory_order_relaxed);
+        counters->accepted = accepted.load(std::memory_order_relaxed);
+        counters->deferred = deferred.load(std::memory_order_relaxed);
+    }
+};
+
+// a boid updated once every few steps takes that many steps' worth of steering
+static Vector2 scaleSteering(Vector2 velocity, Vector2 next, float scale)
+{
+    if (scale == 1) return next;
+    return Vector2Add(velocity, Vector2Scale(Vector2Subtract(next, velocity), scale));
+}
+
+UpdateSchedule makeUpdateSchedule(const GameData &data)
+{
+    UpdateSchedule schedule;
+    if (data.config.offscreenSlices <= 1 || data.view.width <= 0 || data.view.height <= 0) return schedule;
+
+    // boids about to come into view are already kept up to date
+    float margin = data.config.visibleRadius;
+    schedule.view = { data.view.x - margin, data.view.y - margin, data.view.width + margin * 2, data.view.height + margin * 2 };
+    schedule.slices = uint32_t(data.config.offscreenSlices);
+    schedule.turn = uint32_t(data.steps % schedule.slices);
+    return schedule;
+}
+
+template <typename Rules, bool Counted>
+static void accumulateNeighbor(Vector2 position, const Position &otherPosition, const Velocity &otherVelocity, const Config &config, NeighborSums &sums)
+{
+    if constexpr (Counted) sums.visited++;
+
+    Vector2 distance = Vector2Subtract(position, otherPosition.p);
+    float length = Vector2Length(distance);
+
+    if constexpr (Rules::needsClose) {
+        if (length <= config.avoidRadius) {
+            sums.close = Vector2Add(sums.close, distance);
+        }
+    }
+
+    // telemetry counts the flock even when no rule reads it
+    if constexpr (Rules::needsFlock || Counted) {
+        if (length <= config.visibleRadius) {
+            sums.count++;
+            if constexpr (Rules::needsFlock) {
+                sums.velocity = Vector2Add(sums.velocity, otherVelocity.v);
+                sums.position = Vector2Add(sums.position, otherPosition.p);
+            }
+        }
+    }
+}
+
+template <typename Rules, bool Counted, typename View, typename Index>
+NeighborSums updateBoid(const View &boids, const Index &index, const Config &config, entt::entity entity, float scale, NextVelocity &next)
+{
+    BoidZoneScoped;
+
+    auto [position, velocity] = boids.get(entity);
+
+    NeighborSums sums = {};
+    if (scale == 0) {
+        next.v = velocity.v;
+        return sums;
+    }
+
+    auto visit = [&](entt::entity otherEntity) {
+        if (entity == otherEntity) return;
+
+        auto [otherPosition, otherVelocity] = boids.get(otherEntity);
+        accumulateNeighbor<Rules, Counted>(position.p, otherPosition, otherVelocity, config, sums);
+    };
+
+    if (config.neighborCap > 0) {
+        index.forEachNearUntil(position, [&](entt::entity otherEntity) {
+            visit(otherEntity);
+            return sums.count < config.neighborCap;
+        });
+    } else {
+        index.forEachNear(position, visit);
+    }
+
+    next.v = scaleSteering(velocity.v, Rules::steer(position.p, velocity.v, sums, config), scale);
+    return sums;
+}
+
+// debug bookkeeping for the selected boids, kept out of the parallel loop
+// since it adds components to the registry
+template <typename Index>
+static void markNeighbors(entt::registry &reg, const Config &config, const Index &index)
+{
+    ZoneScoped;
+
+    reg.clear<Neighbor>();
+
+    auto selected = reg.view<const Position, const Selected>();
+    for (auto [entity, position] : selected.each()) {
+        index.forEachNear(position, [&](entt::entity otherEntity) {
+            if (entity == otherEntity) return;
+
+            auto &otherPosition = reg.get<Position>(otherEntity);
+            if (Vector2Length(Vector2Subtract(position.p, otherPosition.p)) <= config.visibleRadius) {
+                reg.emplace_or_replace<Neighbor>(otherEntity);
+            }
+        });
+    }
+}
+
+// updateTurnFactor, avoidObstacles, mustGoFaster and moveEntities for one
+// boid, with the speed limits worked out from a single length
+static void integrateBoid(Vector2 &position, Vector2 &lastPosition, Vector2 &velocity, const Config &config, const Integration &integration)
+{
+    float dt = integration.dt;
+
+    if (position.x < config.bounds.x) {
+        velocity.x += config.turnFactor;
+    } else if (position.x > config.bounds.width + config.bounds.x) {
+        velocity.x -= config.turnFactor;
+    }
+
+    if (position.y < config.bounds.y) {
+        velocity.y += config.turnFactor;
+    } else if (position.y > config.bounds.height + config.bounds.y) {
+        velocity.y -= config.turnFactor;
+    }
+
+    if (integration.obstacles) {
+        velocity = obstacleSteering(*integration.obstacles, config, position, velocity);
+    }
+
+    // lerping toward the same direction at maxSpeed only changes the length
+    float length = Vector2Length(velocity);
+    if (length > 0) {
+        float wanted = length < config.maxSpeed ? length + (config.maxSpeed - length) * dt : length;
+        wanted = std::min(wanted, config.maxSpeed);
+        if (wanted != length) {
+            velocity = Vector2Scale(velocity, wanted / length);
+        }
+    }
+
+    lastPosition = position;
+    position = Vector2Add(position, Vector2Scale(velocity, dt));
+}
+
+// every boid has its next velocity, make it the current one, and integrate
+// it too when integration.dt > 0
+static void commitNextVelocities(entt::registry &reg, const Config &config, const Integration &integration, ThreadPool &pool)
+{
+    ZoneScoped;
+
+    auto &velocities = reg.storage<Velocity>();
+    auto &nextVelocities = reg.storage<NextVelocity>();
+
+    if (integration.dt <= 0) {
+        parallelEachBoid(reg, pool, passGrain, [&](entt::entity entity) {
+            velocities.get(entity).v = nextVelocities.get(entity).v;
+        });
+        return;
+    }
+
+    const auto boids = reg.view<Position, LastPosition>();
+    parallelEachBoid(reg, pool, passGrain, [&](entt::entity entity) {
+        auto [position, lastPosition] = boids.get(entity);
+        Vector2 &velocity = velocities.get(entity).v;
+        velocity = nextVelocities.get(entity).v;
+        integrateBoid(position.p, lastPosition.p, velocity, config, integration);
+    });
+}
+
+template <typename Rules, bool Counted, typename Index>
+static void boidLogicWith(entt::registry &reg, Config &config, const Index &index, ThreadPool &pool, SimCounters *counters, const UpdateSchedule &schedule, const Integration &integration)
+{
+    ZoneScoped;
+
+    // every boid reads last frame's velocities and writes its own next one
+    const auto boids = std::as_const(reg).view<const Position, const Velocity>();
+    auto &nextVelocities = reg.storage<NextVelocity>();
+    const entt::entity *entities = reg.storage<Boid>().data();
+    NeighborTally tally;
+    pool.parallelFor(reg.storage<Boid>().size(), logicGrain, [&](size_t begin, size_t end, int worker) {
+        uint64_t visited = 0;
+        uint64_t accepted = 0;
+        int deferred = 0;
+        for (size_t i = begin; i < end; i++) {
+            float scale = schedule.scale(entities[i], boids.get<const Position>(entities[i]).p);
+            NeighborSums sums = updateBoid<Rules, Counted>(boids, index, config, entities[i], scale, nextVelocities.get(entities[i]));
+            visited += sums.visited;
+            accepted += sums.count;
+            deferred += scale == 0;
+        }
+        tally.add(visited, accepted, deferred);
+    });
+    tally.report(counters);
+
+    commitNextVelocities(reg, config, integration, pool);
+}
+
+void boidLogic(entt::registry &reg, Config &config, const SpatialHash &spatialHash, ThreadPool &pool, SimCounters *counters, const UpdateSchedule &schedule, const Integration &integration)
+{
+    markNeighbors(reg, config, spatialHash);
+
+    withLogicVariant(config, counters, [&](auto rules, auto counted) {
+        boidLogicWith<decltype(rules), decltype(counted)::value>(reg, config, spatialHash, pool, counters, schedule, integration);
+    });
+}
+
+// same as boidLogicWith but reading neighbors from the grid's packed copies
+// in slot order, so neighboring boids are also neighbors in memory
+template <typename Rules>
+static void boidLogicPacked(entt::registry &reg, Config &config, const UniformGrid &grid, ThreadPool &pool, SimCounters *counters, const UpdateSchedule &schedule, const Integration &integration)
+{
+    ZoneScoped;
+
+    bool simd = config.neighborKernel == KERNEL_SIMD;
+    bool aggregate = config.neighborKernel == KERNEL_AGGREGATE;
+    // measuring the approximation means running the exact kernel as well
+    bool measureError = aggregate && counters;
+    // summed per chunk and merged under the lock, so nothing is allocated
+    std::mutex errorMutex;
+    double error = 0;
+    int errorSamples = 0;
+
+    auto &nextVelocities = reg.storage<NextVelocity>();
+    NeighborTally tally;
+    pool.parallelFor(grid.entities.size(), logicGrain, [&](size_t begin, size_t end, int worker) {
+        uint64_t visited = 0;
+        uint64_t accepted = 0;
+        int deferred = 0;
+        double chunkError = 0;
+        int chunkSamples = 0;
+        for (size_t i = begin; i < end; i++) {
+            uint32_t slot = uint32_t(i);
+            entt::entity entity = grid.entities[slot];
+            Vector2 position = { grid.positionsX[slot], grid.positionsY[slot] };
+            Vector2 velocity = { grid.velocitiesX[slot], grid.velocitiesY[slot] };
+
+            float scale = schedule.scale(entity, position);
+            Vector2 next = velocity;
+            if (scale == 0) {
+                deferred++;
+            } else {
+                NeighborSums sums = aggregate ? sumNeighborsAggregated(grid, slot, config) : sumNeighborsPacked(grid, slot, config, simd);
+                visited += sums.visited;
+                accepted += sums.count;
+                next = scaleSteering(velocity, Rules::steer(position, velocity, sums, config), scale);
+            }
+
+            nextVelocities.get(entity).v = next;
+
+            if (scale == 0) continue;
+
+            if (measureError && slot % aggregateErrorStride == 0) {
+                Vector2 exact = scaleSteering(velocity, Rules::steer(position, velocity, sumNeighborsPacked(grid, slot, config, true), config), scale);
+                float length = Vector2Length(exact);
+                if (length > 0) {
+                    chunkError += Vector2Distance(next, exact) / length;
+                    chunkSamples++;
+                }
+            }
+        }
+        tally.add(visited, accepted, deferred);
+
+        if (chunkSamples > 0) {
+            std::lock_guard lock(errorMutex);
+            error += chunkError;
+            errorSamples += chunkSamples;
+        }
+    });
+    tally.report(counters);
+
+    if (measureError) {
+        counters->aggregateError = errorSamples > 0 ? float(error / errorSamples) : 0.0f;
+    }
+
+    commitNextVelocities(reg, config, integration, pool);
+}
+
+void boidLogic(entt::registry &reg, Config &config, const UniformGrid &grid, ThreadPool &pool, SimCounters *counters, const UpdateSchedule &schedule, const Integration &integration)
+{
+    markNeighbors(reg, config, grid);
+
+    // the packed kernels sum every field in vector lanes either way, only
+    // the steering is specialized
+    withLogicVariant(config, counters, [&](auto rules, auto counted) {
+        if (config.neighborKernel == KERNEL_ENTITY) {
+            boidLogicWith<decltype(rules), decltype(counted)::value>(reg, config, grid, pool, counters, schedule, integration);
+        } else {
+            boidLogicPacked<decltype(rules)>(reg, config, grid, pool, counters, schedule, integration);
+        }
+    });
+}
+
+// Chunk c of the build collects its boids' lists into chunkNeighbors[c],
+// which are then stitched together in order.
+template <typename Index>
+static void buildNeighborLists(entt::registry &reg, const Config &config, const Index &index, NeighborLists &lists, ThreadPool &pool)
+{
+    ZoneScoped;
+
+    const auto &boids = reg.storage<Boid>();
+    const auto &positions = reg.storage<Position>();
+    const entt::entity *entities = boids.data();
+    size_t count = boids.size();
+    size_t chunks = (count + logicGrain - 1) / logicGrain;
+
+    float reach = getNeighborReach(&config);
+    float reachSq = reach * reach;
+
+    lists.owners.assign(entities, entities + count);
+    lists.builtAt.resize(count);
+    lists.start.resize(count + 1);
+    lists.chunkNeighbors.resize(chunks);
+
+    pool.parallelFor(count, logicGrain, [&](size_t begin, size_t end, int worker) {
+        auto &chunk = lists.chunkNeighbors[begin / logicGrain];
+        chunk.clear();
+        chunk.reserve(lists.chunkCapacity);
+
+        for (size_t i = begin; i < end; i++) {
+            entt::entity entity = entities[i];
+            Vector2 p = positions.get(entity).p;
+            lists.builtAt[i] = p;
+            // relative to the chunk until the chunks are stitched
+            lists.start[i] = uint32_t(chunk.size());
+
+            index.forEachNear(Position{ p }, [&](entt::entity other) {
+                if (other == entity) return;
+
+                Vector2 d = Vector2Subtract(p, positions.get(other).p);
+                if (d.x * d.x + d.y * d.y <= reachSq) {
+                    chunk.push_back(other);
+                }
+            });
+        }
+    });
+
+    uint32_t offset = 0;
+    for (size_t c = 0; c < chunks; c++) {
+        // grown in steps, every step reallocates every chunk
+        size_t size = lists.chunkNeighbors[c].size();
+        if (size > lists.chunkCapacity) {
+            lists.chunkCapacity = size + size / 2;
+        }
+
+        size_t end = std::min((c + 1) * logicGrain, count);
+        for (size_t i = c * logicGrain; i < end; i++) {
+            lists.start[i] += offset;
+        }
+        offset += uint32_t(lists.chunkNeighbors[c].size());
+    }
+    lists.start[count] = offset;
+
+    // with the same headroom, density shifts shouldn't reallocate
+    if (offset > lists.neighbors.capacity()) {
+        lists.neighbors.reserve(offset + offset / 4);
+    }
+    lists.neighbors.resize(offset);
+    pool.parallelFor(chunks, 1, [&](size_t begin, size_t end, int worker) {
+        for (size_t c = begin; c < end; c++) {
+            auto &chunk = lists.chunkNeighbors[c];
+            std::copy(chunk.begin(), chunk.end(), lists.neighbors.begin() + lists.start[c * logicGrain]);
+        }
+    });
+
+    lists.builtReach = reach;
+    lists.builtSkin = config.neighborSkin;
+}
+
+// same as boidLogicWith but walking each boid's cached neighbor list
+template <typename Rules, bool Counted>
+static void boidLogicListed(entt::registry &reg, Config &config, const NeighborLists &lists, ThreadPool &pool, SimCounters *counters, const UpdateSchedule &schedule, const Integration &integration)
+{
+    ZoneScoped;
+
+    const auto boids = std::as_const(reg).view<const Position, const Velocity>();
+    auto &nextVelocities = reg.storage<NextVelocity>();
+    const entt::entity *entities = reg.storage<Boid>().data();
+    NeighborTally tally;
+    pool.parallelFor(reg.storage<Boid>().size(), logicGrain, [&](size_t begin, size_t end, int worker) {
+        uint64_t visited = 0;
+        uint64_t accepted = 0;
+        int deferred = 0;
+        for (size_t i = begin; i < end; i++) {
+            auto [position, velocity] = boids.get(entities[i]);
+
+            float scale = schedule.scale(entities[i], position.p);
+            if (scale == 0) {
+                nextVelocities.get(entities[i]).v = velocity.v;
+                deferred++;
+                continue;
+            }
+
+            NeighborSums sums = {};
+            for (uint32_t n = lists.start[i]; n < lists.start[i + 1]; n++) {
+                auto [otherPosition, otherVelocity] = boids.get(lists.neighbors[n]);
+                accumulateNeighbor<Rules, Counted>(position.p, otherPosition, otherVelocity, config, sums);
+            }
+
+            nextVelocities.get(entities[i]).v = scaleSteering(velocity.v, Rules::steer(position.p, velocity.v, sums, config), scale);
+            visited += sums.visited;
+            accepted += sums.count;
+        }
+        tally.add(visited, accepted, deferred);
+    });
+    tally.report(counters);
+
+    commitNextVelocities(reg, config, integration, pool);
+}
+
+// boidLogicListed after rebuilding the lists if they went stale; returns
+// whether they were
+template <typename Index>
+static bool boidLogicListed(entt::registry &reg, Config &config, const Index &index, NeighborLists &lists, ThreadPool &pool, SimCounters *counters, const UpdateSchedule &schedule, const Integration &integration)
+{
+    markNeighbors(reg, config, index);
+
+    bool rebuild = neighborListsStale(reg, config, lists, pool);
+    if (rebuild) {
+        buildNeighborLists(reg, config, index, lists, pool);
+    }
+
+    withLogicVariant(config, counters, [&](auto rules, auto counted) {
+        boidLogicListed<decltype(rules), decltype(counted)::value>(reg, config, lists, pool, counters, schedule, integration);
+    });
+    return rebuild;
+}
+
+void boidLogic(GameData &data, SimCounters *counters, float integrateDt)
+{
+    Integration integration = { integrateDt, data.obstacles.empty() ? nullptr : &data.obstacles };
+
+    UpdateSchedule schedule = makeUpdateSchedule(data);
+
+    bool queried = true;
+    if (data.config.neighborSkin > 0) {
+        if (data.config.spatialMode == SPATIAL_GRID) {
+            queried = boidLogicListed(data.reg, data.config, data.grid, data.neighborLists, data.pool, counters, schedule, integration);
+        } else {
+            queried = boidLogicListed(data.reg, data.config, data.spatialHash, data.neighborLists, data.pool, counters, schedule, integration);
+        }
+        if (counters) counters->neighborListBuilds = queried;
+    } else if (data.config.spatialMode == SPATIAL_GRID) {
+        boidLogic(data.reg, data.config, data.grid, data.pool, counters, schedule, integration);
+    } else {
+        boidLogic(data.reg, data.config, data.spatialHash, data.pool, counters, schedule, integration);
+    }
+
+    if (counters && queried) {
+        // the grid reads every cell in reach of the boid, the hash did that
+        // work up front and a query is a single lookup
+        int side = 2 * getSpatialRadius(&data.config) + 1;
+        uint64_t cellsPerQuery = data.config.spatialMode == SPATIAL_GRID ? uint64_t(side) * side : 1;
+        counters->cellsTouched += cellsPerQuery * (data.reg.storage<Boid>().size() - counters->deferred);
+    }
+}
+
+void measureSpatialIndex(const GameData &data, SimCounters &counters)
+{
+    ZoneScoped;
+
+    counters.occupiedCells = 0;
+    counters.maxOccupancy = 0;
+    counters.meanOccupancy = 0;
+
+    size_t total = 0;
+    auto count = [&](size_t occupancy) {
+        if (occupancy == 0) return;
+        counters.occupiedCells++;
+        counters.maxOccupancy = std::max(counters.maxOccupancy, int(occupancy));
+        total += occupancy;
+    };
+
+    if (data.config.spatialMode == SPATIAL_GRID) {
+        for (uint32_t occupancy : data.grid.cellCount) count(occupancy);
+        counters.indexBytes = data.grid.memoryUsage();
+    } else {
+        for (auto &[c, set] : data.spatialHash.hash) count(set.size());
+        counters.indexBytes = data.spatialHash.memoryUsage();
+    }
+
+    if (counters.occupiedCells > 0) {
+        counters.meanOccupancy = float(total) / counters.occupiedCells;
+    }
+    if (data.config.neighborSkin > 0) {
+        counters.indexBytes += data.neighborLists.memoryUsage();
+    }
+}
+
+void mustGoFaster(entt::registry &reg, Config &config, float delta, ThreadPool &pool)
+{
+    ZoneScoped;
+
+    auto &velocities = reg.storage<Velocity>();
+    parallelEachBoid(reg, pool, passGrain, [&](entt::entity entity) {
+        auto &velocity = velocities.get(entity);
+
+        if (Vector2Length(velocity.v) < config.maxSpeed) {
+            velocity.v = Vector2Lerp(velocity.v, Vector2Multiply(Vector2Normalize(velocity.v), Vector2{ config.maxSpeed, config.maxSpeed }), delta);
+        }
+
+        if (Vector2Length(velocity.v) > config.maxSpeed) {
+            velocity.v = Vector2ClampValue(velocity.v, config.minSpeed, config.maxSpeed);
+        }
+    });
+}
+
+void updateSpatialHash(GameData &data, SimCounters *counters)
+{
+    ZoneScoped;
+
+    if (data.config.spatialMode == SPATIAL_GRID) {
+        data.grid.area = data.indexArea;
+        data.grid.rebuild(data.reg);
+        sizeCellSizeTuning(data);
+        return;
+    }
+
+    // boids at full speed coast maxSpeed^2 / (2 * turnFactor) steps' worth
+    // past the bounds before they have turned around
+    const Config &config = data.config;
+    float stepSeconds = config.simRate > 0 ? 1.0f / config.simRate : 1.0f / 60.0f;
+    float overshoot = config.turnFactor > 0 ? config.maxSpeed * config.maxSpeed / (2 * config.turnFactor) * stepSeconds : 0;
+    Rectangle bounds = config.bounds;
+    float margin = overshoot + getNeighborReach(&config) + config.cellSize;
+    Rectangle area = { bounds.x - margin, bounds.y - margin, bounds.width + margin * 2, bounds.height + margin * 2 };
+    // an index area comes with its margin, cells past it are made as needed
+    if (data.indexArea.width > 0 && data.indexArea.height > 0) area = data.indexArea;
+    const Rectangle &reserved = data.spatialHash.reservedArea;
+    if (area.x != reserved.x || area.y != reserved.y || area.width != reserved.width || area.height != reserved.height) {
+        data.spatialHash.reserveCells(area);
+    }
+
+    auto boids = data.reg.view<const Boid, const Position>();
+
+    uint64_t moved = 0;
+    for (auto [entity, p] : boids.each()) {
+        // only touches the hash when the boid moved to another cell
+        moved += data.spatialHash.insert(entity, p);
+    }
+
+    if (counters) {
+        // a move erases the boid from every cell around its old home and
+        // inserts it into every cell around the new one
+        int side = 2 * getSpatialRadius(&data.config) + 1;
+        counters->cellsTouched += moved * 2 * uint64_t(side) * side;
+    }
+}
+
+void collectBoidsInRect(const GameData &data, Rectangle rect, std::vector<entt::entity> &out)
+{
+    ZoneScoped;
+
+    out.clear();
+
+    if (data.config.spatialMode == SPATIAL_GRID) {
+        // whole cells, so a few boids just outside rect come along
+        const auto &grid = data.grid;
+        grid.forEachRangeInRect(rect, [&](uint32_t begin, uint32_t end) {
+            out.insert(out.end(), grid.entities.begin() + begin, grid.entities.begin() + end);
+        });
+        return;
+    }
+
+    for (auto [entity, position] : data.reg.view<const Boid, const Position>().each()) {
+        if (position.p.x >= rect.x && position.p.x <= rect.x + rect.width && position.p.y >= rect.y && position.p.y <= rect.y + rect.height) {
+            out.push_back(entity);
+        }
+    }
+}
+
+void selectNearest(GameData &data, Vector2 point, bool additive)
+{
+    auto &reg = data.reg;
+
+    if (!additive) {
+        reg.clear<Selected>();
+    }
+
+    entt::entity minEntity = entt::null;
+    float minDistance = FLT_MAX;
+    forEachNear(data, { point }, [&](entt::entity entity) {
+        auto position = reg.get<Position>(entity);
+
+        auto distance = Vector2Distance(position.p, point);
+        if (distance < minDistance) {
+            minDistance = distance;
+            minEntity = entity;
+        }
+    });
+
+    if (reg.valid(minEntity) && !reg.all_of<Selected>(minEntity)) {
+        reg.emplace<Selected>(minEntity);
+    }
+}
+
+void markCandidates(GameData &data)
+{
+    ZoneScoped;
+
+    auto &reg = data.reg;
+    reg.clear<Candidate>();
+
+    auto selected = reg.view<Position, Selected>();
+    for (auto [entity, position] : selected.each()) {
+        forEachNear(data, position, [&](entt::entity e) {
+            if (e != entity) {
+                reg.emplace_or_replace<Candidate>(e);
+            }
+        });
+    }
+}
+
+// interleave the low 16 bits of x and y
+static uint32_t mortonCode(uint32_t x, uint32_t y)
+{
+    auto spread = [](uint32_t v) {
+        v &= 0xffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+
+    return spread(x) | (spread(y) << 1);
+}
+
+template <typename... Component>
+static void sortStoragesAs(entt::registry &reg, const std::vector<entt::entity> &order)
+{
+    (reg.storage<Component>().sort_as(order.begin(), order.end()), ...);
+}
+
+void sortBoidStorage(GameData &data)
+{
+    ZoneScoped;
+
+    if (data.config.sortInterval <= 0 || ++data.framesSinceSort < data.config.sortInterval) return;
+    data.framesSinceSort = 0;
+
+    auto &reg = data.reg;
+
+    if (data.config.spatialMode == SPATIAL_GRID) {
+        // the grid was just rebuilt, its slots are already in cell order
+        data.sortOrder.assign(data.grid.entities.begin(), data.grid.entities.end());
+    } else {
+        auto &keys = data.sortKeys;
+        keys.clear();
+        for (auto [entity, position] : reg.view<const Boid, const Position>().each()) {
+            auto c = data.spatialHash.positionToCell(position);
+            keys.emplace_back(mortonCode(uint32_t(c.first), uint32_t(c.second)), entity);
+        }
+
+        std::sort(keys.begin(), keys.end());
+
+        data.sortOrder.clear();
+        for (auto [key, entity] : keys) {
+            data.sortOrder.push_back(entity);
+        }
+    }
+
+    sortStoragesAs<Boid, Position, Velocity, NextVelocity, LastPosition, BoidColor>(reg, data.sortOrder);
+}
+
+struct SystemTimer {
+    SimTimings *timings;
+    SimSystem system;
+    std::chrono::steady_clock::time_point start;
+
+    SystemTimer(SimTimings *timings, SimSystem system) : timings(timings), system(system), start(std::chrono::steady_clock::now()) {};
+
+    ~SystemTimer() {
+        if (timings) {
+            timings->seconds[system] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+};
+
+void step(GameData &data, float dt, SimTimings *timings, SimCounters *counters)
+{
+    ZoneScoped;
+
+    if (timings) *timings = {};
+    if (counters) *counters = {};
+
+    data.pool.resize(data.config.threadCount);
+
+    {
+        SystemTimer t(timings, SYSTEM_SPAWN);
+        spawnBoids(data);
+    }
+
+    {
+        SystemTimer t(timings, SYSTEM_SPATIAL);
+        updateSpatialHash(data, counters);
+        if (tuneCellSize(data) && counters) {
+            counters->cellResizes = 1;
+        }
+    }
+
+    if (counters) {
+        counters->boids = int(data.reg.storage<Boid>().size());
+        counters->cellSize = data.config.cellSize;
+        measureSpatialIndex(data, *counters);
+    }
+
+    {
+        SystemTimer t(timings, SYSTEM_SORT);
+        sortBoidStorage(data);
+    }
+
+    if (data.paused) return;
+
+    if (data.config.fusedIntegration && dt > 0) {
+        // turn, speed and move happen inside the logic pass and are timed
+        // with it
+        SystemTimer t(timings, SYSTEM_LOGIC);
+        boidLogic(data, counters, dt);
+        data.steps++;
+        return;
+    }
+
+    {
+        SystemTimer t(timings, SYSTEM_LOGIC);
+        boidLogic(data, counters);
+    }
+
+    {
+        SystemTimer t(timings, SYSTEM_TURN);
+        updateTurnFactor(data.reg, data.config, data.pool);
+        if (!data.obstacles.empty()) {
+            avoidObstacles(data.reg, data.config, data.obstacles, data.pool);
+        }
+    }
+
+    {
+        SystemTimer t(timings, SYSTEM_SPEED);
+        mustGoFaster(data.reg, data.config, dt, data.pool);
+    }
+
+    {
+        SystemTimer t(timings, SYSTEM_MOVE);
+        moveEntities(data.reg, dt, data.pool);
+    }
+
+    data.steps++;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "game.h"
+#include "telemetry.h"
+
+// create count boids at once with zeroed state, for callers that bring
+// their own; created is overwritten with the new entities
+void createBoidsBulk(entt::registry &reg, size_t count, std::vector<entt::entity> &created);
+// create count boids at once, filling their components in parallel from
+// seed; created is overwritten with the new entities
+void spawnBoidsBulk(entt::registry &reg, const Config &config, size_t count, uint64_t seed, ThreadPool &pool, std::vector<entt::entity> &created);
+// destroy count boids at once; destroyed is overwritten with the old entities
+void despawnBoidsBulk(entt::registry &reg, size_t count, std::vector<entt::entity> &destroyed);
+// spawn or despawn until there are config.count boids
+void spawnBoids(GameData &data);
+void updateSpatialHash(GameData &data, SimCounters *counters = nullptr);
+
+// Which boids get their neighbor update this step: every boid in view, and
+// of the rest one in slices, taking turns, with their steering scaled by
+// slices to make up for the steps they sit out. The default updates all.
+struct UpdateSchedule {
+    Rectangle view = {};
+    uint32_t slices = 1;
+    uint32_t turn = 0;
+
+    // 0 when the boid sits this step out, otherwise its steering scale
+    float scale(entt::entity entity, Vector2 position) const
+    {
+        if (slices <= 1) return 1;
+
+        bool inView = position.x >= view.x && position.x <= view.x + view.width
+            && position.y >= view.y && position.y <= view.y + view.height;
+        if (inView) return 1;
+
+        return entt::to_entity(entity) % slices == turn ? float(slices) : 0;
+    }
+};
+
+UpdateSchedule makeUpdateSchedule(const GameData &data);
+void sortBoidStorage(GameData &data);
+// what the logic pass needs to integrate the boids as it commits their new
+// velocities; with dt 0 it doesn't and updateTurnFactor, avoidObstacles,
+// mustGoFaster and moveEntities are left to the caller
+struct Integration {
+    float dt = 0;
+    const ObstacleField *obstacles = nullptr;
+};
+
+void boidLogic(entt::registry &reg, Config &config, const SpatialHash &spatialHash, ThreadPool &pool, SimCounters *counters = nullptr, const UpdateSchedule &schedule = {}, const Integration &integration = {});
+void boidLogic(entt::registry &reg, Config &config, const UniformGrid &grid, ThreadPool &pool, SimCounters *counters = nullptr, const UpdateSchedule &schedule = {}, const Integration &integration = {});
+// pick the logic pass for the config: cached neighbor lists, packed grid
+// kernels or registry lookups through the active index
+void boidLogic(GameData &data, SimCounters *counters = nullptr, float integrateDt = 0);
+// occupancy and memory of the active spatial index
+void measureSpatialIndex(const GameData &data, SimCounters &counters);
+// the separate integration passes, the reference for config.fusedIntegration
+void updateTurnFactor(entt::registry &reg, Config &config, ThreadPool &pool);
+void avoidObstacles(entt::registry &reg, const Config &config, const ObstacleField &obstacles, ThreadPool &pool);
+void mustGoFaster(entt::registry &reg, Config &config, float delta, ThreadPool &pool);
+void moveEntities(entt::registry &reg, float deltaTime, ThreadPool &pool);
+
+// boids inside rect, found through the grid's cells in grid mode
+void collectBoidsInRect(const GameData &data, Rectangle rect, std::vector<entt::entity> &out);
+
+// select the boid closest to point, adding to the selection if additive
+void selectNearest(GameData &data, Vector2 point, bool additive);
+// tag every boid the spatial index offers as a neighbor of a selected one
+void markCandidates(GameData &data);
+
+// advance the simulation by dt seconds, no windowing or input involved;
+// counters cost a pass over the spatial index, leave them null when unused
+void step(GameData &data, float dt, SimTimings *timings = nullptr, SimCounters *counters = nullptr);
+
+// visit every boid the active spatial index reports as near position
+template <typename Func>
+void forEachNear(const GameData &data, const Position &position, Func &&func)
+{
+    if (data.config.spatialMode == SPATIAL_GRID) {
+        data.grid.forEachNear(position, func);
+    } else {
+        data.spatialHash.forEachNear(position, func);
+    }
+}
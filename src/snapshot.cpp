@@ -0,0 +1,93 @@
+#include "tracy/Tracy.hpp"
+
+#include "snapshot.h"
+#include "entities.h"
+
+static const size_t snapshotGrain = 8192;
+
+static void copyBoids(const entt::registry &reg, const entt::entity *entities, size_t count, ThreadPool &pool, Snapshot &snapshot)
+{
+    snapshot.count = int(count);
+    snapshot.positions.resize(count);
+    snapshot.lastPositions.resize(count);
+    snapshot.velocities.resize(count);
+
+    const auto view = reg.view<const Position, const LastPosition, const Velocity>();
+    pool.parallelFor(count, snapshotGrain, [&](size_t begin, size_t end, int worker) {
+        for (size_t i = begin; i < end; i++) {
+            auto [position, lastPosition, velocity] = view.get(entities[i]);
+            snapshot.positions[i] = position.p;
+            snapshot.lastPositions[i] = lastPosition.p;
+            snapshot.velocities[i] = velocity.v;
+        }
+    });
+}
+
+static void captureCommon(const entt::registry &reg, const Config &config, float dt, double time, Snapshot &snapshot)
+{
+    const auto *boids = reg.storage<Boid>();
+
+    snapshot.config = config;
+    snapshot.dt = dt;
+    snapshot.time = time;
+    snapshot.total = boids ? int(boids->size()) : 0;
+    snapshot.highlights.clear();
+    snapshot.selected.clear();
+
+    for (auto [entity, position] : reg.view<const Selected, const Position>().each()) {
+        snapshot.selected.push_back(position.p);
+    }
+}
+
+void captureSnapshot(const entt::registry &reg, const Config &config, float dt, double time, ThreadPool &pool, Snapshot &snapshot)
+{
+    ZoneScoped;
+
+    captureCommon(reg, config, dt, time, snapshot);
+
+    const auto *boids = reg.storage<Boid>();
+    if (!boids) {
+        copyBoids(reg, nullptr, 0, pool, snapshot);
+        return;
+    }
+
+    copyBoids(reg, boids->data(), boids->size(), pool, snapshot);
+
+    // later tags win, Candidate < Neighbor < Selected
+    for (auto entity : reg.view<const Candidate>()) {
+        if (boids->contains(entity)) snapshot.highlights.emplace_back(uint32_t(boids->index(entity)), GREEN);
+    }
+    for (auto entity : reg.view<const Neighbor>()) {
+        if (boids->contains(entity)) snapshot.highlights.emplace_back(uint32_t(boids->index(entity)), RED);
+    }
+    for (auto entity : reg.view<const Selected>()) {
+        if (boids->contains(entity)) snapshot.highlights.emplace_back(uint32_t(boids->index(entity)), BLUE);
+    }
+}
+
+void captureSnapshot(const entt::registry &reg, const Config &config, const std::vector<entt::entity> &entities, float dt, double time, ThreadPool &pool, Snapshot &snapshot)
+{
+    ZoneScoped;
+
+    captureCommon(reg, config, dt, time, snapshot);
+    copyBoids(reg, entities.data(), entities.size(), pool, snapshot);
+
+    // the captured boids are not in storage order, so check the few
+    // tagged ones by entity instead
+    const auto *candidates = reg.storage<Candidate>();
+    const auto *neighbors = reg.storage<Neighbor>();
+    const auto *selected = reg.storage<Selected>();
+    bool anyTags = (candidates && !candidates->empty()) || (neighbors && !neighbors->empty()) || (selected && !selected->empty());
+    if (!anyTags) return;
+
+    for (size_t i = 0; i < entities.size(); i++) {
+        entt::entity entity = entities[i];
+        if (selected && selected->contains(entity)) {
+            snapshot.highlights.emplace_back(uint32_t(i), BLUE);
+        } else if (neighbors && neighbors->contains(entity)) {
+            snapshot.highlights.emplace_back(uint32_t(i), RED);
+        } else if (candidates && candidates->contains(entity)) {
+            snapshot.highlights.emplace_back(uint32_t(i), GREEN);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "raylib.h"
+
+#include "config.h"
+#include "governor.h"
+#include "telemetry.h"
+#include "thread_pool.h"
+
+// Everything the renderer needs from one simulation step, copied out of the
+// registry so it can be drawn while the next step is already running.
+// Boid i is the i-th of the entities captured, all boids in Boid storage
+// order unless the capture was culled to the view.
+struct Snapshot {
+    std::vector<Vector2> positions;
+    std::vector<Vector2> lastPositions;
+    std::vector<Vector2> velocities;
+
+    // boids drawn in a debug color, by index
+    std::vector<std::pair<uint32_t, Color>> highlights;
+    std::vector<Vector2> selected;
+
+    Config config = {};
+    int count = 0;
+    // boids in the simulation, captured or not
+    int total = 0;
+    float dt = 0;
+    double time = 0;
+
+    // of the last step; counters stay zero unless SimInput::telemetry
+    SimTimings timings;
+    SimCounters counters;
+    // what the governor gave up for this step, budget 0 without one
+    FrameGovernor governor;
+};
+
+void captureSnapshot(const entt::registry &reg, const Config &config, float dt, double time, ThreadPool &pool, Snapshot &snapshot);
+// capture only the given boids, e.g. the ones in view
+void captureSnapshot(const entt::registry &reg, const Config &config, const std::vector<entt::entity> &entities, float dt, double time, ThreadPool &pool, Snapshot &snapshot);
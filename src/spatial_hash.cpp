@@ -1,6 +1,11 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "tracy/Tracy.hpp"
 
 #include "spatial_hash.h"
+#include "telemetry.h"
 
 static std::pair<int, int> positionToCell(float x, float y, float cellSize)
 {
@@ -12,15 +17,16 @@ static std::pair<int, int> positionToCell(const Position &p, float cellSize)
     return positionToCell(p.p.x, p.p.y, cellSize);
 }
 
-static int hashCell(std::pair<int, int> p) {
-    return p.first * 92837111 + p.second * 689287499;
+float getNeighborReach(const Config *config)
+{
+    return fmax(config->avoidRadius, config->visibleRadius) + fmax(config->neighborSkin, 0.0f);
 }
 
-static int getSpatialRadius(const Config *config)
+int getSpatialRadius(const Config *config)
 {
     int radius = 1;
 
-    float maxRadiustoCheck = fmax(config->avoidRadius, config->visibleRadius);
+    float maxRadiustoCheck = getNeighborReach(config);
 
     if (maxRadiustoCheck > config->cellSize) {
         radius = int(ceilf(maxRadiustoCheck / config->cellSize));
@@ -29,49 +35,152 @@ static int getSpatialRadius(const Config *config)
     return radius;
 }
 
-void SpatialHash::insert(entt::entity e, Position p, Velocity v, LastPosition l, bool force)
+static bool isReserved(const SpatialHash &spatialHash, cell c)
 {
-    ZoneScoped;
+    return c.first >= spatialHash.reservedLo.first && c.first <= spatialHash.reservedHi.first &&
+           c.second >= spatialHash.reservedLo.second && c.second <= spatialHash.reservedHi.second;
+}
 
-    int radius = getSpatialRadius(config);
+// take e out of every cell around home, without creating missing ones;
+// outside cells left empty go back to the spares
+static void eraseAround(SpatialHash &spatialHash, entt::entity e, const SpatialHash::Home &home)
+{
+    for (int y = home.center.second - home.radius; y <= home.center.second + home.radius; y++) {
+        for (int x = home.center.first - home.radius; x <= home.center.first + home.radius; x++) {
+            auto it = spatialHash.hash.find(cell(x, y));
+            if (it == spatialHash.hash.end()) continue;
+
+            it->second.erase(e);
+            if (it->second.empty() && !isReserved(spatialHash, it->first) && spatialHash.spareCells.size() < spatialHash.spareCells.capacity()) {
+                spatialHash.spareCells.push_back(spatialHash.hash.extract(it));
+            }
+        }
+    }
+}
 
-    auto newCellPos = positionToCell(p, config->cellSize);
-    auto lastPos = positionToCell({ l.p }, config->cellSize);
+// past this a cell's bucket chains just get longer, every cell reserved
+// after a tune would otherwise get a table for the densest clump yet
+static const size_t maxCellBuckets = 1024;
 
-    // if we aren't forcing it, we will remove it.
-    if (!force && newCellPos.first == lastPos.first && newCellPos.second == lastPos.second) return;
+// a bucket table sized once, when the cell is first used, and never grown:
+// a set is only ever walked whole or searched for one boid, so a crowded
+// cell costs a longer bucket chain rather than a rehash mid-frame
+void SpatialHash::prepareCell(underlying_set &set) const
+{
+    if (set.bucket_count() > 1) return;
 
-    for (int y = lastPos.second - radius; y <= lastPos.second + radius; y++) {
-        for (int x = lastPos.first - radius; x <= lastPos.first + radius; x++) {
-            hash[cell(x, y)].erase(e);
-        }
+    set.max_load_factor(std::numeric_limits<float>::max());
+    set.rehash(cellCapacity);
+}
+
+SpatialHash::underlying_set &SpatialHash::cellAt(cell c)
+{
+    auto it = hash.find(c);
+    if (it != hash.end()) return it->second;
+
+    if (spareCells.empty()) {
+        auto &set = hash[c];
+        prepareCell(set);
+        return set;
+    }
+
+    auto node = std::move(spareCells.back());
+    spareCells.pop_back();
+    node.key() = c;
+    return hash.insert(std::move(node)).position->second;
+}
+
+bool SpatialHash::insert(entt::entity e, const Position &p)
+{
+    int radius = getSpatialRadius(config);
+    auto newCellPos = positionToCell(p);
+
+    auto [it, inserted] = homes.try_emplace(e, Home{ newCellPos, radius });
+    if (!inserted) {
+        Home &home = it->second;
+        if (home.center == newCellPos && home.radius == radius) return false;
+
+        eraseAround(*this, e, home);
+        home = { newCellPos, radius };
     }
 
-    {
-        for (int y = newCellPos.second - radius; y <= newCellPos.second + radius; y++) {
-            for (int x = newCellPos.first - radius; x <= newCellPos.first + radius; x++) {
-                hash[cell(x, y)].insert(e);
+    for (int y = newCellPos.second - radius; y <= newCellPos.second + radius; y++) {
+        for (int x = newCellPos.first - radius; x <= newCellPos.first + radius; x++) {
+            auto &set = cellAt(cell(x, y));
+            if (set.size() >= cellCapacity && cellCapacity < maxCellBuckets) {
+                cellCapacity = std::min(cellCapacity * 2, maxCellBuckets);
             }
+            set.insert(e);
         }
     }
+
+    return true;
 }
 
 void SpatialHash::remove(entt::entity e)
+{
+    auto it = homes.find(e);
+    if (it == homes.end()) return;
+
+    eraseAround(*this, e, it->second);
+    homes.erase(it);
+}
+
+void SpatialHash::reserveCells(Rectangle area)
 {
     ZoneScoped;
 
-    for (auto& [_key, value] : hash) {
-        value.erase(e);
+    reservedArea = area;
+
+    // a boid in area is inserted into the cells radius around its own too
+    int radius = getSpatialRadius(config);
+    cell lo = positionToCell(Position{ { area.x, area.y } });
+    cell hi = positionToCell(Position{ { area.x + area.width, area.y + area.height } });
+    lo = { lo.first - radius, lo.second - radius };
+    hi = { hi.first + radius, hi.second + radius };
+    reservedLo = lo;
+    reservedHi = hi;
+
+    // spares for a few rings of cells just outside, the stray boids are
+    // spread thin along the edges
+    size_t width = size_t(hi.first - lo.first + 1);
+    size_t height = size_t(hi.second - lo.second + 1);
+    size_t spares = 4 * 2 * (width + height) * size_t(radius);
+    hash.reserve(hash.size() + width * height + spares);
+    spareCells.reserve(spareCells.size() + spares);
+
+    for (int y = lo.second; y <= hi.second; y++) {
+        for (int x = lo.first; x <= hi.first; x++) {
+            prepareCell(hash[cell(x, y)]);
+        }
+    }
+
+    // made under keys nothing uses, then set aside until a boid needs them
+    cell unused = { hi.first + 1, lo.second };
+    while (spareCells.size() < spares) {
+        auto it = hash.try_emplace(unused).first;
+        prepareCell(it->second);
+        spareCells.push_back(hash.extract(it));
     }
 }
 
+void SpatialHash::clear()
+{
+    hash.clear();
+    homes.clear();
+    spareCells.clear();
+    reservedArea = {};
+    reservedLo = { 0, 0 };
+    reservedHi = { -1, -1 };
+}
+
 const SpatialHash::underlying_set emptySet;
 
 const SpatialHash::underlying_set& SpatialHash::get_all_near_position(const Position& position) const
 {
-    ZoneScoped;
+    BoidZoneScoped;
 
-    auto cell = positionToCell(position, config->cellSize);
+    auto cell = positionToCell(position);
 
     if (hash.find(cell) == hash.end()) return emptySet;
 
@@ -79,19 +188,26 @@ const SpatialHash::underlying_set& SpatialHash::get_all_near_position(const Posi
 }
 
 
-void drawSpatialHashGrid(const entt::registry& reg, const SpatialHash& hash)
+cell SpatialHash::positionToCell(const Position &position) const
 {
-    ZoneScoped;
+    return ::positionToCell(position, config->cellSize);
+}
 
-    auto selected = reg.view<Position, Selected>();
-    for (auto [entity, position] : selected.each()) {
-        float cellSize = hash.config->cellSize;
-        auto cell = positionToCell(position, cellSize);
-        int radius = getSpatialRadius(hash.config);
-        for (int y = cell.second - radius; y <= cell.second + radius; y++) {
-            for (int x = cell.first - radius; x <= cell.first + radius; x++) {
-                DrawRectangleLines(int(floorf(x * cellSize)), int(floorf(y * cellSize)), int(cellSize), int(cellSize), RED);
-            }
-        }
+size_t SpatialHash::memoryUsage() const
+{
+    // a node holds the value and a next pointer, plus the cached hash
+    const size_t nodeOverhead = sizeof(void *) + sizeof(size_t);
+
+    size_t bytes = hash.bucket_count() * sizeof(void *) + homes.bucket_count() * sizeof(void *);
+    bytes += hash.size() * (sizeof(std::pair<const cell, underlying_set>) + nodeOverhead);
+    bytes += homes.size() * (sizeof(std::pair<const entt::entity, Home>) + nodeOverhead);
+
+    for (auto &[c, set] : hash) {
+        bytes += set.bucket_count() * sizeof(void *) + set.size() * (sizeof(entt::entity) + nodeOverhead);
     }
-}
\ No newline at end of file
+    for (auto &node : spareCells) {
+        bytes += sizeof(std::pair<const cell, underlying_set>) + nodeOverhead + node.mapped().bucket_count() * sizeof(void *);
+    }
+
+    return bytes;
+}
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include <entt/entt.hpp>
 
 #include "config.h"
 #include "entities.h"
+#include "recycling_allocator.h"
 
 typedef std::pair<int,int> cell;
 
@@ -11,9 +16,7 @@ struct CellHash
 {
     size_t operator()(const cell &cell) const
     {
-        int result = 0;
-        result = std::_Fnv1a_append_value(result, cell.first);
-        return std::_Fnv1a_append_value(result, cell.second);
+        return size_t(cell.first) * 92837111 ^ size_t(cell.second) * 689287499;
     }
 };
 
@@ -25,17 +28,75 @@ struct CellEqual
     }
 };
 
+// farthest a boid looks for neighbors, including the neighbor list skin
+float getNeighborReach(const Config *config);
+// how many cells around a boid's cell can hold boids within its reach
+int getSpatialRadius(const Config *config);
+
+// Node containers churn a node for every cell a boid enters or leaves, so
+// they recycle them to keep steady state frames off the heap.
 struct SpatialHash {
-    typedef std::unordered_set<entt::entity> underlying_set;
-    std::unordered_map<cell, underlying_set, CellHash, CellEqual> hash;
+    typedef std::unordered_set<entt::entity, std::hash<entt::entity>, std::equal_to<entt::entity>, RecyclingAllocator<entt::entity>> underlying_set;
+
+    // where an entity was last inserted, so it can be found again without
+    // searching every cell
+    struct Home {
+        cell center;
+        int radius;
+    };
+
+    std::unordered_map<cell, underlying_set, CellHash, CellEqual, RecyclingAllocator<std::pair<const cell, underlying_set>>> hash;
+    std::unordered_map<entt::entity, Home, std::hash<entt::entity>, std::equal_to<entt::entity>, RecyclingAllocator<std::pair<const entt::entity, Home>>> homes;
     const Config *config;
 
-    void insert(entt::entity e, Position p, Velocity v, LastPosition l, bool force = false);
+    // buckets given to a cell when it is first used, doubled whenever a cell
+    // reaches it; cells never rehash after, see prepareCell
+    size_t cellCapacity = 16;
+    // the area reserveCells last created cells for, and its cells
+    Rectangle reservedArea = {};
+    cell reservedLo = { 0, 0 };
+    cell reservedHi = { -1, -1 };
+    // cells outside the reserved area that emptied, kept with their bucket
+    // tables to be keyed again for the next stray boid; flocks overshoot the
+    // bounds by more than any margin, so outside cells come and go for good
+    std::vector<decltype(hash)::node_type> spareCells;
+
+    // adds e, or moves it if its cell changed since it was last inserted;
+    // returns false when nothing had to change
+    bool insert(entt::entity e, const Position &p);
     void remove(entt::entity e);
+    // create the cells over area up front, so boids spreading into it later
+    // don't grow the map mid-frame
+    void reserveCells(Rectangle area);
+    // give a new cell its fixed bucket table
+    void prepareCell(underlying_set &set) const;
+    // the cell at c, made from a spare one if it doesn't exist yet
+    underlying_set &cellAt(cell c);
+    // drop every boid and cell, spares included
+    void clear();
     const underlying_set &get_all_near_position(const Position &position) const;
 
-    SpatialHash(const Config* config) : config(config) {};
-};
+    template <typename Func>
+    void forEachNear(const Position &position, Func &&func) const
+    {
+        for (auto &e : get_all_near_position(position)) {
+            func(e);
+        }
+    }
 
+    // forEachNear until func returns false; a cell's set is in no spatial
+    // order, so stopping early takes an even sample of the neighborhood
+    template <typename Func>
+    void forEachNearUntil(const Position &position, Func &&func) const
+    {
+        for (auto &e : get_all_near_position(position)) {
+            if (!func(e)) return;
+        }
+    }
 
-void drawSpatialHashGrid(const entt::registry &reg, const SpatialHash &hash);
\ No newline at end of file
+    cell positionToCell(const Position &position) const;
+    // estimate, the standard containers don't report their allocations
+    size_t memoryUsage() const;
+
+    SpatialHash(const Config* config) : config(config) {};
+};
@@ -0,0 +1,44 @@
+#include "telemetry.h"
+
+const char *simSystemNames[SYSTEM_COUNT] = {
+    "spawn",
+    "spatial",
+    "sort",
+    "logic",
+    "turn",
+    "speed",
+    "move",
+};
+
+void writeTelemetryCsvHeader(FILE *file)
+{
+    fprintf(file, "frame");
+    for (int s = 0; s < SYSTEM_COUNT; s++) {
+        fprintf(file, ",%s_ms", simSystemNames[s]);
+    }
+    fprintf(file, ",boids,visited,accepted,cells_touched,occupied_cells,max_occupancy,mean_occupancy,index_bytes,list_builds,aggregate_error,deferred,cell_size,cell_resizes,governor_level\n");
+}
+
+void writeTelemetryCsv(FILE *file, int frame, const SimTimings &timings, const SimCounters &counters)
+{
+    fprintf(file, "%d", frame);
+    for (int s = 0; s < SYSTEM_COUNT; s++) {
+        fprintf(file, ",%.4f", timings.seconds[s] * 1e3);
+    }
+    fprintf(file, ",%d,%llu,%llu,%llu,%d,%d,%.2f,%zu,%d,%.6f,%d,%.2f,%d,%d\n", counters.boids,
+        (unsigned long long)counters.visited, (unsigned long long)counters.accepted, (unsigned long long)counters.cellsTouched,
+        counters.occupiedCells, counters.maxOccupancy, counters.meanOccupancy, counters.indexBytes, counters.neighborListBuilds, counters.aggregateError, counters.deferred,
+        counters.cellSize, counters.cellResizes, counters.governorLevel);
+}
+
+void writeTelemetryJson(FILE *file, int frame, const SimTimings &timings, const SimCounters &counters)
+{
+    fprintf(file, "{\"frame\": %d", frame);
+    for (int s = 0; s < SYSTEM_COUNT; s++) {
+        fprintf(file, ", \"%s_ms\": %.4f", simSystemNames[s], timings.seconds[s] * 1e3);
+    }
+    fprintf(file, ", \"boids\": %d, \"visited\": %llu, \"accepted\": %llu, \"cells_touched\": %llu, \"occupied_cells\": %d, \"max_occupancy\": %d, \"mean_occupancy\": %.2f, \"index_bytes\": %zu, \"list_builds\": %d, \"aggregate_error\": %.6f, \"deferred\": %d, \"cell_size\": %.2f, \"cell_resizes\": %d, \"governor_level\": %d}\n",
+        counters.boids, (unsigned long long)counters.visited, (unsigned long long)counters.accepted, (unsigned long long)counters.cellsTouched,
+        counters.occupiedCells, counters.maxOccupancy, counters.meanOccupancy, counters.indexBytes, counters.neighborListBuilds, counters.aggregateError, counters.deferred,
+        counters.cellSize, counters.cellResizes, counters.governorLevel);
+}
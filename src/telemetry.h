@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#include "tracy/Tracy.hpp"
+
+// Tracy zones inside per-boid loops cost more than the work they measure
+// at high counts, so they are only compiled in with BOIDS_PER_BOID_ZONES
+#if defined(BOIDS_PER_BOID_ZONES)
+#define BoidZoneScoped ZoneScoped
+#else
+#define BoidZoneScoped
+#endif
+
+enum SimSystem {
+    SYSTEM_SPAWN,
+    SYSTEM_SPATIAL,
+    SYSTEM_SORT,
+    SYSTEM_LOGIC,
+    SYSTEM_TURN,
+    SYSTEM_SPEED,
+    SYSTEM_MOVE,
+    SYSTEM_COUNT,
+};
+
+extern const char *simSystemNames[SYSTEM_COUNT];
+
+// wall clock seconds spent in each system during the last step
+struct SimTimings {
+    double seconds[SYSTEM_COUNT] = {};
+};
+
+// what the last step did, to tell why it took as long as it did
+struct SimCounters {
+    int boids = 0;
+
+    // neighbor candidates the spatial index handed the logic pass, and how
+    // many of them were within visibleRadius
+    uint64_t visited = 0;
+    uint64_t accepted = 0;
+
+    // cells read by neighbor queries plus cells the hash rewrote for boids
+    // that moved to another cell
+    uint64_t cellsTouched = 0;
+
+    // boids per non-empty cell; hash cells hold every boid in reach of them
+    int occupiedCells = 0;
+    int maxOccupancy = 0;
+    float meanOccupancy = 0;
+
+    size_t indexBytes = 0;
+
+    // boids off screen that sat this step's neighbor update out
+    int deferred = 0;
+
+    // 1 when this step rebuilt the neighbor lists
+    int neighborListBuilds = 0;
+
+    // the spatial index's cell size, and 1 when this step re-selected it
+    float cellSize = 0;
+    int cellResizes = 0;
+
+    // the FrameGovernor level in effect, 0 at full fidelity or without one
+    int governorLevel = 0;
+
+    // KERNEL_AGGREGATE only: mean of |approximate - exact| / |exact| new
+    // velocity over a sample of boids
+    float aggregateError = 0;
+};
+
+void writeTelemetryCsvHeader(FILE *file);
+void writeTelemetryCsv(FILE *file, int frame, const SimTimings &timings, const SimCounters &counters);
+// one JSON object per line
+void writeTelemetryJson(FILE *file, int frame, const SimTimings &timings, const SimCounters &counters);
@@ -0,0 +1,97 @@
+#include "tracy/Tracy.hpp"
+
+#include "thread_pool.h"
+
+void ThreadPool::start(int threadCount)
+{
+    stop();
+
+    if (threadCount <= 0) {
+        threadCount = int(std::thread::hardware_concurrency());
+    }
+
+    stopping = false;
+    for (int i = 1; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+void ThreadPool::resize(int threadCount)
+{
+    if (threadCount <= 0) {
+        threadCount = int(std::thread::hardware_concurrency());
+    }
+
+    if (threadCount != size()) {
+        start(threadCount);
+    }
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::run(size_t count, size_t grain, JobFunc job, void *context)
+{
+    {
+        std::lock_guard lock(mutex);
+        this->job = job;
+        this->context = context;
+        this->count = count;
+        this->grain = grain;
+        next = 0;
+        active = int(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    // the job context lives on the caller's stack, so wait for every
+    // worker to let go of it, not just for the last chunk to finish
+    std::unique_lock lock(mutex);
+    done.wait(lock, [this] { return active == 0; });
+}
+
+void ThreadPool::work(int worker)
+{
+    while (true) {
+        size_t begin = next.fetch_add(grain);
+        if (begin >= count) break;
+
+        size_t end = begin + grain < count ? begin + grain : count;
+        job(context, begin, end, worker);
+    }
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+    uint64_t seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+
+        work(worker);
+
+        {
+            std::lock_guard lock(mutex);
+            active--;
+        }
+        done.notify_one();
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that split index ranges between them.
+// The calling thread takes part as worker 0, so a pool of size 1 has no
+// threads and runs everything inline.
+struct ThreadPool {
+    typedef void (*JobFunc)(void *context, size_t begin, size_t end, int worker);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    JobFunc job = nullptr;
+    void *context = nullptr;
+    size_t count = 0;
+    size_t grain = 1;
+    std::atomic<size_t> next{0};
+    int active = 0;
+
+    // threadCount includes the caller, 0 picks one per hardware thread
+    void start(int threadCount);
+    void stop();
+    // restarts the workers only if the thread count actually changes
+    void resize(int threadCount);
+    int size() const { return int(workers.size()) + 1; }
+
+    // calls func(begin, end, worker) on chunks [k * grain, (k + 1) * grain)
+    // covering [0, count) and returns once all of them are done; chunks are
+    // the same whatever the thread count, so per chunk state is deterministic
+    template <typename Func>
+    void parallelFor(size_t count, size_t grain, Func &&func)
+    {
+        if (workers.empty() || count <= grain) {
+            for (size_t begin = 0; begin < count; begin += grain) {
+                func(begin, std::min(begin + grain, count), 0);
+            }
+            return;
+        }
+
+        run(count, grain, [](void *context, size_t begin, size_t end, int worker) {
+            (*static_cast<std::remove_reference_t<Func> *>(context))(begin, end, worker);
+        }, &func);
+    }
+
+    void run(size_t count, size_t grain, JobFunc job, void *context);
+    void work(int worker);
+    void workerLoop(int worker);
+
+    ThreadPool() = default;
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool() { stop(); }
+};
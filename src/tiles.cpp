@@ -0,0 +1,483 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <new>
+#include <thread>
+
+#include "raymath.h"
+
+#include "tracy/Tracy.hpp"
+
+#include "sim.h"
+#include "tiles.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BOIDS_TILES_SUPPORTED 1
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#endif
+
+int TileLayout::columnOf(float x) const
+{
+    int column = int(floorf((x - bounds.x) / bounds.width * columns));
+    return std::clamp(column, 0, columns - 1);
+}
+
+int TileLayout::rowOf(float y) const
+{
+    int row = int(floorf((y - bounds.y) / bounds.height * rows));
+    return std::clamp(row, 0, rows - 1);
+}
+
+Rectangle TileLayout::tileRect(int tile) const
+{
+    float width = bounds.width / columns;
+    float height = bounds.height / rows;
+    return { bounds.x + (tile % columns) * width, bounds.y + (tile / columns) * height, width, height };
+}
+
+float TileLayout::distanceSqrTo(int tile, Vector2 p) const
+{
+    Rectangle rect = tileRect(tile);
+    int column = tile % columns;
+    int row = tile / columns;
+
+    // the outer tiles reach out forever
+    float left = column == 0 ? -INFINITY : rect.x;
+    float right = column == columns - 1 ? INFINITY : rect.x + rect.width;
+    float top = row == 0 ? -INFINITY : rect.y;
+    float bottom = row == rows - 1 ? INFINITY : rect.y + rect.height;
+
+    float dx = p.x < left ? left - p.x : (p.x > right ? p.x - right : 0);
+    float dy = p.y < top ? top - p.y : (p.y > bottom ? p.y - bottom : 0);
+    return dx * dx + dy * dy;
+}
+
+#ifdef BOIDS_TILES_SUPPORTED
+
+// what a worker reports about its last step, by the parity of the step
+struct TileHeader {
+    int owned[2];
+    int exported[2];
+    int migrated[2];
+    double stepSeconds[2];
+};
+
+// Start of the shared mapping, followed by a TileHeader per tile and then
+// the record buffers. Each tile has two exports and two owned buffers and
+// alternates between them by step parity: a step reads the neighbors'
+// exports from the last step while writing its own for the next, and the
+// coordinator reads the owned boids of a step while the next is written.
+struct TileShared {
+    pthread_barrier_t barrier;
+    // the barrier after which the workers exit
+    std::atomic<uint64_t> stopAfter;
+    int tiles;
+    size_t capacity;
+    size_t headersOffset;
+    size_t exportsOffset;
+    size_t ownedOffset;
+};
+
+static size_t alignUp(size_t bytes)
+{
+    return (bytes + 63) & ~size_t(63);
+}
+
+static TileHeader &tileHeader(TileShared *shared, int tile)
+{
+    return reinterpret_cast<TileHeader *>(reinterpret_cast<char *>(shared) + shared->headersOffset)[tile];
+}
+
+static TileRecord *tileExports(TileShared *shared, int tile, int parity)
+{
+    return reinterpret_cast<TileRecord *>(reinterpret_cast<char *>(shared) + shared->exportsOffset) + (size_t(tile) * 2 + parity) * shared->capacity;
+}
+
+static TileRecord *tileOwned(TileShared *shared, int tile, int parity)
+{
+    return reinterpret_cast<TileRecord *>(reinterpret_cast<char *>(shared) + shared->ownedOffset) + (size_t(tile) * 2 + parity) * shared->capacity;
+}
+
+// create boids for records, indexing them like spawnBoids does
+static void addBoids(GameData &data, const std::vector<TileRecord> &records, std::vector<entt::entity> &created)
+{
+    auto &reg = data.reg;
+    createBoidsBulk(reg, records.size(), created);
+
+    auto &positions = reg.storage<Position>();
+    auto &lastPositions = reg.storage<LastPosition>();
+    auto &velocities = reg.storage<Velocity>();
+    for (size_t i = 0; i < records.size(); i++) {
+        positions.get(created[i]).p = records[i].position;
+        lastPositions.get(created[i]).p = records[i].lastPosition;
+        velocities.get(created[i]).v = records[i].velocity;
+    }
+
+    if (data.config.spatialMode == SPATIAL_HASH) {
+        for (auto entity : created) {
+            data.spatialHash.insert(entity, positions.get(entity));
+        }
+    }
+}
+
+static void removeBoids(GameData &data, const std::vector<entt::entity> &entities)
+{
+    if (data.config.spatialMode == SPATIAL_HASH) {
+        for (auto entity : entities) {
+            data.spatialHash.remove(entity);
+        }
+    }
+    data.reg.destroy(entities.begin(), entities.end());
+}
+
+struct TileWorker {
+    TileShared *shared;
+    TileLayout layout;
+    int tile;
+    float reach;
+    // tiles close enough to send halo boids or migrants
+    std::vector<int> neighbors;
+
+    std::vector<TileRecord> arrivals;
+    std::vector<TileRecord> halo;
+    std::vector<entt::entity> ghosts;
+    std::vector<entt::entity> leaving;
+};
+
+// take over the boids handed to this tile and copy in the halo
+static void importBoids(GameData &data, TileWorker &worker, int parity)
+{
+    ZoneScoped;
+
+    worker.arrivals.clear();
+    worker.halo.clear();
+    float reachSq = worker.reach * worker.reach;
+
+    for (int from : worker.neighbors) {
+        const TileRecord *records = tileExports(worker.shared, from, parity);
+        int count = tileHeader(worker.shared, from).exported[parity];
+
+        for (int i = 0; i < count; i++) {
+            if (records[i].owner == worker.tile) {
+                worker.arrivals.push_back(records[i]);
+            } else if (worker.layout.distanceSqrTo(worker.tile, records[i].position) < reachSq) {
+                worker.halo.push_back(records[i]);
+            }
+        }
+    }
+
+    // the boids this tile handed over last step are still neighbors of the
+    // ones it kept, and the new owner exported before it had them
+    const TileRecord *own = tileExports(worker.shared, worker.tile, parity);
+    int ownCount = tileHeader(worker.shared, worker.tile).exported[parity];
+    for (int i = 0; i < ownCount; i++) {
+        if (own[i].owner != worker.tile && worker.layout.distanceSqrTo(worker.tile, own[i].position) < reachSq) {
+            worker.halo.push_back(own[i]);
+        }
+    }
+
+    addBoids(data, worker.arrivals, data.spawnScratch);
+    addBoids(data, worker.halo, worker.ghosts);
+}
+
+// publish the owned boids, hand the ones that left to their new tile and
+// export the ones near an edge as the neighbors' halo
+static void exportBoids(GameData &data, TileWorker &worker, int parity)
+{
+    ZoneScoped;
+
+    TileRecord *owned = tileOwned(worker.shared, worker.tile, parity);
+    TileRecord *exports = tileExports(worker.shared, worker.tile, parity);
+    int ownedCount = 0;
+    int exported = 0;
+    int migrated = 0;
+    float reachSq = worker.reach * worker.reach;
+
+    worker.leaving.clear();
+    const auto &boids = data.reg.storage<Boid>();
+    const auto view = data.reg.view<const Position, const LastPosition, const Velocity>();
+    for (auto entity : boids) {
+        auto [position, lastPosition, velocity] = view.get(entity);
+        TileRecord record = { position.p, lastPosition.p, velocity.v, int32_t(worker.tile) };
+
+        int owner = worker.layout.tileOf(position.p);
+        if (owner != worker.tile) {
+            record.owner = owner;
+            exports[exported++] = record;
+            worker.leaving.push_back(entity);
+            migrated++;
+            continue;
+        }
+
+        owned[ownedCount++] = record;
+        for (int to : worker.neighbors) {
+            if (worker.layout.distanceSqrTo(to, position.p) < reachSq) {
+                exports[exported++] = record;
+                break;
+            }
+        }
+    }
+
+    removeBoids(data, worker.leaving);
+
+    TileHeader &header = tileHeader(worker.shared, worker.tile);
+    header.owned[parity] = ownedCount;
+    header.exported[parity] = exported;
+    header.migrated[parity] = migrated;
+}
+
+static void runTileWorker(TileShared *shared, const TileLayout &layout, int tile, const Config &config, const ObstacleField &obstacles, float dt, uint64_t seed, size_t count)
+{
+    GameData data;
+    data.config = config;
+    // entities are recreated every step, cached lists would go stale
+    data.config.neighborSkin = 0;
+    data.config.offscreenSlices = 1;
+    // the tile is too small a sample of the density to tune for
+    data.config.cellSizeInterval = 0;
+    if (data.config.threadCount <= 0) {
+        data.config.threadCount = std::max(1, int(std::thread::hardware_concurrency()) / layout.count());
+    }
+    data.obstacles = obstacles;
+    data.pool.resize(data.config.threadCount);
+
+    TileWorker worker;
+    worker.shared = shared;
+    worker.layout = layout;
+    worker.tile = tile;
+    worker.reach = getNeighborReach(&data.config);
+
+    // a boid moves at most maxSpeed * dt a step, so migrants come from
+    // tiles that close as well
+    float contact = std::max(worker.reach, config.maxSpeed * dt);
+    Rectangle rect = layout.tileRect(tile);
+    for (int other = 0; other < layout.count(); other++) {
+        Rectangle o = layout.tileRect(other);
+        float dx = std::max({ 0.0f, o.x - (rect.x + rect.width), rect.x - (o.x + o.width) });
+        float dy = std::max({ 0.0f, o.y - (rect.y + rect.height), rect.y - (o.y + o.height) });
+        if (other != tile && dx * dx + dy * dy <= contact * contact) {
+            worker.neighbors.push_back(other);
+        }
+    }
+
+    // index the tile and the margin its halo and arrivals come from, not
+    // the world; boids past the bounds in the outer tiles are clamped in
+    data.indexArea = { rect.x - contact, rect.y - contact, rect.width + contact * 2, rect.height + contact * 2 };
+
+    // this tile's share of the boids, spawned inside it
+    Config spawnConfig = data.config;
+    spawnConfig.bounds = rect;
+    spawnBoidsBulk(data.reg, spawnConfig, count, Rng(seed, uint64_t(tile)).next64(), data.pool, data.spawnScratch);
+    if (data.config.spatialMode == SPATIAL_HASH) {
+        for (auto entity : data.spawnScratch) {
+            data.spatialHash.insert(entity, data.reg.get<Position>(entity));
+        }
+    }
+
+    exportBoids(data, worker, 0);
+    pthread_barrier_wait(&shared->barrier);
+
+    for (uint64_t s = 0; shared->stopAfter.load() != s; s++) {
+        auto start = std::chrono::steady_clock::now();
+        int parity = int(s % 2);
+
+        importBoids(data, worker, parity);
+
+        data.config.count = int(data.reg.storage<Boid>().size());
+        step(data, dt);
+
+        removeBoids(data, worker.ghosts);
+        exportBoids(data, worker, parity ^ 1);
+
+        tileHeader(shared, tile).stepSeconds[parity ^ 1] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        pthread_barrier_wait(&shared->barrier);
+    }
+}
+
+bool startTiles(TileCluster &cluster, const Config &config, const ObstacleField &obstacles, int columns, int rows, float dt, uint64_t seed)
+{
+    if (columns < 1 || rows < 1 || config.bounds.width <= 0 || config.bounds.height <= 0) return false;
+
+    cluster.layout = { config.bounds, columns, rows };
+    cluster.capacity = size_t(std::max(config.count, 1));
+    cluster.dt = dt;
+    cluster.steps = 0;
+    int tiles = cluster.layout.count();
+    cluster.offsets.assign(size_t(tiles) + 1, 0);
+
+    // buffers are sized for every boid landing in one tile, but only the
+    // pages actually written are ever backed by memory
+    size_t headersOffset = alignUp(sizeof(TileShared));
+    size_t exportsOffset = alignUp(headersOffset + sizeof(TileHeader) * tiles);
+    size_t ownedOffset = alignUp(exportsOffset + sizeof(TileRecord) * cluster.capacity * 2 * tiles);
+    cluster.sharedBytes = ownedOffset + sizeof(TileRecord) * cluster.capacity * 2 * tiles;
+
+    void *memory = mmap(nullptr, cluster.sharedBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) return false;
+
+    TileShared *shared = new (memory) TileShared;
+    shared->stopAfter = UINT64_MAX;
+    shared->tiles = tiles;
+    shared->capacity = cluster.capacity;
+    shared->headersOffset = headersOffset;
+    shared->exportsOffset = exportsOffset;
+    shared->ownedOffset = ownedOffset;
+
+    pthread_barrierattr_t attributes;
+    pthread_barrierattr_init(&attributes);
+    pthread_barrierattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_barrier_init(&shared->barrier, &attributes, unsigned(tiles + 1));
+    pthread_barrierattr_destroy(&attributes);
+
+    cluster.shared = shared;
+    cluster.workers.clear();
+
+    size_t count = size_t(std::max(config.count, 0));
+    for (int tile = 0; tile < tiles; tile++) {
+        size_t share = count / tiles + (size_t(tile) < count % tiles ? 1 : 0);
+
+        pid_t pid = fork();
+        if (pid == 0) {
+#ifdef __linux__
+            // don't outlive a coordinator that crashed
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+            runTileWorker(shared, cluster.layout, tile, config, obstacles, dt, seed, share);
+            _exit(0);
+        }
+
+        if (pid < 0) {
+            // the barrier would never fill, take down the ones started
+            for (int worker : cluster.workers) {
+                kill(worker, SIGKILL);
+                waitpid(worker, nullptr, 0);
+            }
+            cluster.workers.clear();
+            pthread_barrier_destroy(&shared->barrier);
+            munmap(memory, cluster.sharedBytes);
+            cluster.shared = nullptr;
+            return false;
+        }
+
+        cluster.workers.push_back(int(pid));
+    }
+
+    // the workers have spawned and exported their boids
+    pthread_barrier_wait(&shared->barrier);
+    return true;
+}
+
+void stepTiles(TileCluster &cluster)
+{
+    ZoneScoped;
+
+    pthread_barrier_wait(&cluster.shared->barrier);
+    cluster.steps++;
+}
+
+void captureTiles(const TileCluster &cluster, const Config &config, double time, ThreadPool &pool, std::vector<size_t> &offsets, Snapshot &snapshot)
+{
+    ZoneScoped;
+
+    TileShared *shared = cluster.shared;
+    int parity = int(cluster.steps % 2);
+    int tiles = cluster.layout.count();
+
+    offsets.resize(tiles + 1);
+    offsets[0] = 0;
+    for (int tile = 0; tile < tiles; tile++) {
+        offsets[tile + 1] = offsets[tile] + size_t(tileHeader(shared, tile).owned[parity]);
+    }
+
+    size_t count = offsets[tiles];
+    snapshot.config = config;
+    snapshot.dt = cluster.dt;
+    snapshot.time = time;
+    snapshot.count = int(count);
+    snapshot.total = int(count);
+    snapshot.highlights.clear();
+    snapshot.selected.clear();
+    snapshot.timings = {};
+    snapshot.counters = {};
+    // room for every boid, so the buffers don't grow as boids come and go
+    snapshot.positions.reserve(cluster.capacity);
+    snapshot.lastPositions.reserve(cluster.capacity);
+    snapshot.velocities.reserve(cluster.capacity);
+    snapshot.positions.resize(count);
+    snapshot.lastPositions.resize(count);
+    snapshot.velocities.resize(count);
+
+    pool.parallelFor(size_t(tiles), 1, [&](size_t begin, size_t end, int worker) {
+        for (size_t tile = begin; tile < end; tile++) {
+            const TileRecord *records = tileOwned(shared, int(tile), parity);
+            for (size_t i = 0, n = offsets[tile + 1] - offsets[tile]; i < n; i++) {
+                snapshot.positions[offsets[tile] + i] = records[i].position;
+                snapshot.lastPositions[offsets[tile] + i] = records[i].lastPosition;
+                snapshot.velocities[offsets[tile] + i] = records[i].velocity;
+            }
+        }
+    });
+}
+
+TileStats tileStats(const TileCluster &cluster, int tile)
+{
+    const TileHeader &header = tileHeader(cluster.shared, tile);
+    int parity = int(cluster.steps % 2);
+
+    TileStats stats;
+    stats.owned = header.owned[parity];
+    stats.exported = header.exported[parity];
+    stats.migrated = header.migrated[parity];
+    stats.stepSeconds = header.stepSeconds[parity];
+    return stats;
+}
+
+void stopTiles(TileCluster &cluster)
+{
+    if (!cluster.shared) return;
+
+    // the workers are between barriers, let them finish the step they are on
+    // and exit after the next one
+    cluster.shared->stopAfter = cluster.steps + 1;
+    pthread_barrier_wait(&cluster.shared->barrier);
+
+    for (int worker : cluster.workers) {
+        waitpid(worker, nullptr, 0);
+    }
+    cluster.workers.clear();
+
+    pthread_barrier_destroy(&cluster.shared->barrier);
+    cluster.shared->~TileShared();
+    munmap(cluster.shared, cluster.sharedBytes);
+    cluster.shared = nullptr;
+}
+
+#else
+
+struct TileShared {};
+
+bool startTiles(TileCluster &cluster, const Config &config, const ObstacleField &obstacles, int columns, int rows, float dt, uint64_t seed)
+{
+    return false;
+}
+
+void stepTiles(TileCluster &cluster) {}
+
+void captureTiles(const TileCluster &cluster, const Config &config, double time, ThreadPool &pool, std::vector<size_t> &offsets, Snapshot &snapshot) {}
+
+TileStats tileStats(const TileCluster &cluster, int tile)
+{
+    return {};
+}
+
+void stopTiles(TileCluster &cluster) {}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "raylib.h"
+
+#include "config.h"
+#include "obstacles.h"
+#include "snapshot.h"
+
+// config.bounds cut into columns x rows equal tiles; the outer tiles also
+// own everything past the bounds on their side
+struct TileLayout {
+    Rectangle bounds = {};
+    int columns = 1;
+    int rows = 1;
+
+    int count() const { return columns * rows; }
+    int tileAt(int column, int row) const { return row * columns + column; }
+    int columnOf(float x) const;
+    int rowOf(float y) const;
+    int tileOf(Vector2 p) const { return tileAt(columnOf(p.x), rowOf(p.y)); }
+    Rectangle tileRect(int tile) const;
+    // squared distance from p to the area tile owns, 0 inside it
+    float distanceSqrTo(int tile, Vector2 p) const;
+};
+
+// a boid as it crosses between processes
+struct TileRecord {
+    Vector2 position;
+    Vector2 lastPosition;
+    Vector2 velocity;
+    // the tile that simulates it from the next step on
+    int32_t owner;
+};
+
+// Per step, as the workers report it after their last stepTiles.
+struct TileStats {
+    int owned = 0;
+    // boids sent to neighbors for their halo, or handed over to them
+    int exported = 0;
+    int migrated = 0;
+    double stepSeconds = 0;
+};
+
+struct TileShared;
+
+// Tiled mode: every tile of config.bounds is simulated by its own worker
+// process running the usual step on the boids it owns, plus read-only
+// copies of the boids within neighbor reach across its edges (the halo).
+// After each step a worker hands boids that left its tile to their new
+// owner and publishes its edge boids as the neighbors' next halo, all
+// through one shared memory mapping set up before forking, and waits on a
+// process-shared barrier with the other workers and the coordinator.
+//
+// POSIX only; startTiles fails elsewhere.
+struct TileCluster {
+    TileLayout layout;
+    std::vector<int> workers;
+    TileShared *shared = nullptr;
+    size_t sharedBytes = 0;
+    // boids each buffer can hold, the total count, so nothing can overflow
+    size_t capacity = 0;
+    float dt = 0;
+    // barriers passed, the owned boids of the last one are readable
+    uint64_t steps = 0;
+    // where each tile's boids start in a capture, sized by startTiles
+    std::vector<size_t> offsets;
+};
+
+// fork columns x rows workers simulating config.count boids with fixed
+// steps of dt; the boids are spread over the tiles by area. Each worker
+// gets config.threadCount threads, or its share of the cores if that is 0.
+// Neighbor list skin and off screen staggering are turned off in the
+// workers, boids come and go every step.
+bool startTiles(TileCluster &cluster, const Config &config, const ObstacleField &obstacles, int columns, int rows, float dt, uint64_t seed);
+// let the workers take one step and wait for all of them
+void stepTiles(TileCluster &cluster);
+// the owned boids of every tile after the last step, in tile order;
+// offsets is scratch, normally cluster.offsets
+void captureTiles(const TileCluster &cluster, const Config &config, double time, ThreadPool &pool, std::vector<size_t> &offsets, Snapshot &snapshot);
+TileStats tileStats(const TileCluster &cluster, int tile);
+// stop and reap the workers and release the shared memory
+void stopTiles(TileCluster &cluster);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of the latest value from one producer thread to one
+// consumer thread. The producer always has a buffer to write into, the
+// consumer always has a complete one to read, and the third sits in the
+// middle holding the newest published value.
+template <typename T>
+struct TripleBuffer {
+    static const uint8_t freshBit = 4;
+
+    T buffers[3];
+    std::atomic<uint8_t> middle{1};
+    uint8_t writeIndex = 0;
+    uint8_t readIndex = 2;
+
+    // producer side
+    T &writeBuffer() { return buffers[writeIndex]; }
+
+    void publish()
+    {
+        writeIndex = middle.exchange(writeIndex | freshBit, std::memory_order_acq_rel) & 3;
+    }
+
+    // consumer side, returns true if a newer value was picked up
+    bool acquire()
+    {
+        if (!(middle.load(std::memory_order_acquire) & freshBit)) return false;
+
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    const T &readBuffer() const { return buffers[readIndex]; }
+};
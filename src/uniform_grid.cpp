@@ -0,0 +1,99 @@
+#include <cmath>
+
+#include "tracy/Tracy.hpp"
+
+#include "uniform_grid.h"
+
+cell UniformGrid::positionToCell(const Position &position) const
+{
+    return cell(int(floorf(position.p.x / cellSize)), int(floorf(position.p.y / cellSize)));
+}
+
+int UniformGrid::cellIndex(const Position &position) const
+{
+    auto c = positionToCell(position);
+    int x = std::clamp(c.first - originX, 0, columns - 1);
+    int y = std::clamp(c.second - originY, 0, rows - 1);
+    return y * columns + x;
+}
+
+size_t UniformGrid::memoryUsage() const
+{
+    return cellStart.capacity() * sizeof(uint32_t)
+        + cellCount.capacity() * sizeof(uint32_t)
+        + entities.capacity() * sizeof(entt::entity)
+        + boidCells.capacity() * sizeof(uint32_t)
+        + (positionsX.capacity() + positionsY.capacity() + velocitiesX.capacity() + velocitiesY.capacity()) * sizeof(float)
+        + (cellPositionsX.capacity() + cellPositionsY.capacity() + cellVelocitiesX.capacity() + cellVelocitiesY.capacity()) * sizeof(float);
+}
+
+void UniformGrid::rebuild(const entt::registry &reg)
+{
+    ZoneScoped;
+
+    // one ring of padding cells so boids slightly outside the bounds
+    // are not all piled into the border cells
+    int padding = getSpatialRadius(config);
+
+    const Rectangle &bounds = area.width > 0 && area.height > 0 ? area : config->bounds;
+    cellSize = config->cellSize;
+    originX = int(floorf(bounds.x / cellSize)) - padding;
+    originY = int(floorf(bounds.y / cellSize)) - padding;
+    columns = int(floorf((bounds.x + bounds.width) / cellSize)) - originX + 1 + padding;
+    rows = int(floorf((bounds.y + bounds.height) / cellSize)) - originY + 1 + padding;
+
+    size_t cells = size_t(columns) * rows;
+    cellCount.assign(cells, 0);
+    cellStart.resize(cells + 1);
+
+    auto boids = reg.view<const Boid, const Position, const Velocity>();
+    boidCells.clear();
+    for (auto [entity, position, velocity] : boids.each()) {
+        int index = cellIndex(position);
+        boidCells.push_back(index);
+        cellCount[index]++;
+    }
+
+    uint32_t total = 0;
+    for (size_t c = 0; c < cells; c++) {
+        cellStart[c] = total;
+        total += cellCount[c];
+    }
+    cellStart[cells] = total;
+
+    // scatter, cellCount is reused as the write cursor and restored after
+    entities.resize(total);
+    positionsX.resize(total);
+    positionsY.resize(total);
+    velocitiesX.resize(total);
+    velocitiesY.resize(total);
+    size_t i = 0;
+    for (auto [entity, position, velocity] : boids.each()) {
+        uint32_t index = boidCells[i++];
+        uint32_t slot = cellStart[index + 1] - cellCount[index]--;
+        entities[slot] = entity;
+        positionsX[slot] = position.p.x;
+        positionsY[slot] = position.p.y;
+        velocitiesX[slot] = velocity.v.x;
+        velocitiesY[slot] = velocity.v.y;
+    }
+
+    for (size_t c = 0; c < cells; c++) {
+        cellCount[c] = cellStart[c + 1] - cellStart[c];
+    }
+
+    if (config->neighborKernel != KERNEL_AGGREGATE) return;
+
+    cellPositionsX.assign(cells, 0);
+    cellPositionsY.assign(cells, 0);
+    cellVelocitiesX.assign(cells, 0);
+    cellVelocitiesY.assign(cells, 0);
+    for (size_t c = 0; c < cells; c++) {
+        for (uint32_t slot = cellStart[c]; slot < cellStart[c + 1]; slot++) {
+            cellPositionsX[c] += positionsX[slot];
+            cellPositionsY[c] += positionsY[slot];
+            cellVelocitiesX[c] += velocitiesX[slot];
+            cellVelocitiesY[c] += velocitiesY[slot];
+        }
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "config.h"
+#include "entities.h"
+#include "spatial_hash.h"
+
+// Flat grid over config->bounds, rebuilt every frame with a counting sort.
+// Every boid lands in exactly one cell and the boids of a cell are stored
+// contiguously in `entities`, so a row of neighboring cells is one range.
+// Positions outside the bounds are clamped to the border cells.
+struct UniformGrid {
+    const Config *config;
+    // the area the cells cover instead of config->bounds, when not empty
+    Rectangle area = {};
+
+    float cellSize = 0;
+    int originX = 0;
+    int originY = 0;
+    int columns = 0;
+    int rows = 0;
+
+    // cellStart has one extra entry so cell c spans [cellStart[c], cellStart[c + 1])
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> cellCount;
+    std::vector<entt::entity> entities;
+    std::vector<uint32_t> boidCells;
+
+    // copies of each slot's position and velocity at rebuild time, packed
+    // in slot order for the SIMD neighbor kernel
+    std::vector<float> positionsX;
+    std::vector<float> positionsY;
+    std::vector<float> velocitiesX;
+    std::vector<float> velocitiesY;
+
+    // sums of the positions and velocities of each cell's boids, only kept
+    // for KERNEL_AGGREGATE
+    std::vector<float> cellPositionsX;
+    std::vector<float> cellPositionsY;
+    std::vector<float> cellVelocitiesX;
+    std::vector<float> cellVelocitiesY;
+
+    void rebuild(const entt::registry &reg);
+
+    cell positionToCell(const Position &position) const;
+    int cellIndex(const Position &position) const;
+    size_t memoryUsage() const;
+
+    // calls func(begin, end) for each contiguous run of slots near position
+    template <typename Func>
+    void forEachRange(const Position &position, Func &&func) const
+    {
+        if (columns == 0) return;
+
+        int radius = getSpatialRadius(config);
+        int index = cellIndex(position);
+        int cx = index % columns;
+        int cy = index / columns;
+
+        int x0 = std::max(cx - radius, 0);
+        int x1 = std::min(cx + radius, columns - 1);
+        int y0 = std::max(cy - radius, 0);
+        int y1 = std::min(cy + radius, rows - 1);
+
+        for (int y = y0; y <= y1; y++) {
+            func(cellStart[y * columns + x0], cellStart[y * columns + x1 + 1]);
+        }
+    }
+
+    // forEachRange with the boid's own row first and then the rows above and
+    // below it in turn, nearest first, until func(begin, end) returns false
+    template <typename Func>
+    void forEachRangeOutward(const Position &position, Func &&func) const
+    {
+        if (columns == 0) return;
+
+        int radius = getSpatialRadius(config);
+        int index = cellIndex(position);
+        int cx = index % columns;
+        int cy = index / columns;
+
+        int x0 = std::max(cx - radius, 0);
+        int x1 = std::min(cx + radius, columns - 1);
+
+        for (int offset = 0; offset <= 2 * radius; offset++) {
+            // 0, -1, +1, -2, +2, ...
+            int y = cy + (offset % 2 ? -(offset + 1) / 2 : offset / 2);
+            if (y < 0 || y >= rows) continue;
+            if (!func(cellStart[y * columns + x0], cellStart[y * columns + x1 + 1])) return;
+        }
+    }
+
+    // calls func(begin, end) for each row's run of slots in the cells
+    // overlapping rect
+    template <typename Func>
+    void forEachRangeInRect(Rectangle rect, Func &&func) const
+    {
+        if (columns == 0) return;
+
+        int first = cellIndex({ { rect.x, rect.y } });
+        int last = cellIndex({ { rect.x + rect.width, rect.y + rect.height } });
+        int x0 = first % columns;
+        int x1 = last % columns;
+
+        for (int y = first / columns; y <= last / columns; y++) {
+            func(cellStart[y * columns + x0], cellStart[y * columns + x1 + 1]);
+        }
+    }
+
+    template <typename Func>
+    void forEachNear(const Position &position, Func &&func) const
+    {
+        forEachRange(position, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                func(entities[i]);
+            }
+        });
+    }
+
+    // forEachNear nearest rows first, until func returns false
+    template <typename Func>
+    void forEachNearUntil(const Position &position, Func &&func) const
+    {
+        forEachRangeOutward(position, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                if (!func(entities[i])) return false;
+            }
+            return true;
+        });
+    }
+
+    UniformGrid(const Config *config) : config(config) {};
+};